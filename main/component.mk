@@ -2,3 +2,12 @@
 # "main" pseudo-component makefile.
 #
 # (Uses default behaviour of compiling all source files in directory, adding 'include' to include path.)
+
+# leaf and relay builds never become root, see MESH_ROLE
+ifndef CONFIG_MESH_ROOT_CAPABLE
+COMPONENT_OBJEXCLUDE += mesh_api.o mesh_capture.o mesh_handoff.o mesh_nodes.o mesh_seq.o mesh_stream.o mesh_uplink.o
+endif
+
+ifndef CONFIG_MESH_SENSOR
+COMPONENT_OBJEXCLUDE += mesh_filter.o mesh_rate.o mesh_tx.o
+endif
@@ -0,0 +1,28 @@
+/* Mesh Root Local Read API
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef __MESH_API_H__
+#define __MESH_API_H__
+
+#include "esp_err.h"
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+/* every node is rendered into a fixed width slot of the /nodes body,
+ * padded with spaces, so one node can be re-rendered in place */
+#define MESH_API_NODE_SLOT       (288)
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+esp_err_t mesh_api_start(void);
+void mesh_api_invalidate_topology(void);
+
+#endif /* __MESH_API_H__ */
@@ -0,0 +1,50 @@
+/* Mesh Reading Rate Budget
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef __MESH_BUDGET_H__
+#define __MESH_BUDGET_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_mesh.h"
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define MESH_FRAME_RATE_FLOOR       (0x21) /* mesh_budget_floor_t, root to every node */
+
+/*******************************************************
+ *                Structures
+ *******************************************************/
+typedef struct __attribute__((packed)) {
+    uint8_t type;
+    uint8_t reserved[3];
+    uint32_t floor_ms;      /* shortest interval between readings, 0: no limit */
+} mesh_budget_floor_t;
+
+typedef struct {
+    uint32_t budget_x100;   /* readings per second allowed into the root */
+    uint32_t load_x100;     /* measured at the last period */
+    uint32_t floor_ms;      /* in force on this node */
+    uint32_t adjustments;   /* floor changes decided as root */
+    uint32_t announced;     /* floor frames sent */
+    uint32_t send_errors;
+    uint32_t received;      /* floor frames taken from a root */
+} mesh_budget_stats_t;
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+esp_err_t mesh_budget_start(void);
+void mesh_budget_recv(const mesh_addr_t *from, const uint8_t *frame, int size);
+uint32_t mesh_budget_floor_ms(void);
+void mesh_budget_get_stats(mesh_budget_stats_t *stats);
+
+#endif /* __MESH_BUDGET_H__ */
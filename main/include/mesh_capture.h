@@ -0,0 +1,63 @@
+/* Mesh Root Ingress Capture
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef __MESH_CAPTURE_H__
+#define __MESH_CAPTURE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_mesh.h"
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define MESH_CAPTURE_MAGIC          (0x5041434d) /* "MCAP" */
+#define MESH_CAPTURE_VERSION        (1)
+
+/*******************************************************
+ *                Structures
+ *******************************************************/
+/* sent once per connection, then records back to back, little endian */
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t root[6];
+    uint16_t snaplen;       /* frame bytes kept per record at most */
+    uint32_t session;       /* random per boot */
+} mesh_capture_hdr_t;
+
+/* followed by caplen bytes of the frame */
+typedef struct __attribute__((packed)) {
+    uint32_t time_ms;       /* receive time since boot */
+    uint16_t time_us;       /* sub-millisecond part */
+    uint8_t from[6];
+    uint16_t flag;          /* esp_mesh_recv flag */
+    uint16_t size;          /* frame size as received */
+    uint16_t caplen;
+    uint16_t dropped;       /* records lost to a full buffer just before this one */
+} mesh_capture_rec_t;
+
+typedef struct {
+    uint32_t captured;
+    uint32_t dropped;
+    uint32_t sent;
+    uint32_t bytes;
+    uint32_t connects;
+    uint32_t used_max;      /* buffer high water mark, bytes */
+} mesh_capture_stats_t;
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+esp_err_t mesh_capture_start(void);
+void mesh_capture_frame(const mesh_addr_t *from, const uint8_t *frame, int size, int flag);
+void mesh_capture_get_stats(mesh_capture_stats_t *stats);
+
+#endif /* __MESH_CAPTURE_H__ */
@@ -0,0 +1,66 @@
+/* Mesh Deferred Binary Log
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef __MESH_DLOG_H__
+#define __MESH_DLOG_H__
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+/* flushed lines are "#DL <hex words>", tools/dlog_decode.py turns them back into text */
+#define MESH_DLOG_LINE_PREFIX   "#DL "
+#define MESH_DLOG_MAX_ARGS      (32)
+
+/*******************************************************
+ *                Macros
+ *******************************************************/
+/* Hot-path logging: only the format address, the tag address and the raw
+ * arguments are stored, formatting happens on the host. Arguments must be
+ * integers, %s and floating point are not supported. */
+#if CONFIG_MESH_DLOG
+#define MESH_DLOG_LEVEL(level, tag, fmt, ...) do {                                  \
+        if (LOG_LOCAL_LEVEL >= (level)) {                                           \
+            const uint32_t _dlog_args[] = { 0, ##__VA_ARGS__ };                     \
+            mesh_dlog_write((level), (tag), (fmt),                                  \
+                            sizeof(_dlog_args) / sizeof(_dlog_args[0]) - 1,         \
+                            _dlog_args + 1);                                        \
+        }                                                                           \
+    } while (0)
+#else
+#define MESH_DLOG_LEVEL(level, tag, fmt, ...) ESP_LOG_LEVEL_LOCAL(level, tag, fmt, ##__VA_ARGS__)
+#endif
+
+#define MESH_DLOGE(tag, fmt, ...) MESH_DLOG_LEVEL(ESP_LOG_ERROR, tag, fmt, ##__VA_ARGS__)
+#define MESH_DLOGW(tag, fmt, ...) MESH_DLOG_LEVEL(ESP_LOG_WARN, tag, fmt, ##__VA_ARGS__)
+#define MESH_DLOGI(tag, fmt, ...) MESH_DLOG_LEVEL(ESP_LOG_INFO, tag, fmt, ##__VA_ARGS__)
+
+/*******************************************************
+ *                Structures
+ *******************************************************/
+typedef struct {
+    uint32_t records;
+    uint32_t dropped;       /* ring full, flush task behind */
+    uint32_t flushed;
+    uint32_t words_max;     /* ring high water mark */
+} mesh_dlog_stats_t;
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+esp_err_t mesh_dlog_init(void);
+void mesh_dlog_write(int level, const char *tag, const char *fmt, int nargs, const uint32_t *args);
+void mesh_dlog_get_stats(mesh_dlog_stats_t *stats);
+void mesh_dlog_benchmark(void);
+
+#endif /* __MESH_DLOG_H__ */
@@ -0,0 +1,59 @@
+/* Mesh Fault Injection and Recovery Metrics
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef __MESH_FAULT_H__
+#define __MESH_FAULT_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+/*******************************************************
+ *                Type Definitions
+ *******************************************************/
+typedef enum {
+    MESH_FAULT_ROOT_FAILOVER = 0,
+    MESH_FAULT_PARENT_CHURN,
+    MESH_FAULT_BURST_LOSS,
+    MESH_FAULT_UPLINK_OUTAGE,
+    MESH_FAULT_MAX,
+} mesh_fault_t;
+
+/*******************************************************
+ *                Structures
+ *******************************************************/
+typedef struct {
+    uint32_t events;            /* disruptions seen, injected or not */
+    uint32_t injected;
+    uint32_t connect_ms_max;    /* until the parent was connected again */
+    uint32_t connect_ms_sum;
+    uint32_t throughput_ms_max; /* until root ingest was back to baseline */
+    uint32_t throughput_ms_sum;
+    uint32_t throughput_samples;
+    uint32_t lost;              /* readings lost around disruptions */
+    uint32_t root_switches;     /* settled events caused by a root change */
+    uint32_t root_switch_lost;  /* part of lost that was around a root change */
+    uint32_t heap_start;        /* free heap when metrics started */
+    uint32_t heap_now;
+    uint32_t heap_min;
+} mesh_fault_stats_t;
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+esp_err_t mesh_fault_start(void);
+void mesh_fault_disrupted(const char *cause);
+void mesh_fault_connected(void);
+void mesh_fault_note_rx(void);
+void mesh_fault_note_imported(uint32_t lost);
+bool mesh_fault_drop_rx(void);
+bool mesh_fault_uplink_down(void);
+void mesh_fault_get_stats(mesh_fault_stats_t *stats);
+
+#endif /* __MESH_FAULT_H__ */
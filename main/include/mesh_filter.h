@@ -0,0 +1,84 @@
+/* Mesh Sensor Sample Filter
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef __MESH_FILTER_H__
+#define __MESH_FILTER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Plain C, no ESP-IDF headers: tools/filter_trace.py builds it on the host. */
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define MESH_FILTER_WINDOW_MAX      (9)
+
+/* quality flags, sent with every reading */
+#define MESH_QUALITY_WARMUP         (0x01) /* median over fewer samples than the window */
+#define MESH_QUALITY_SMOOTHED       (0x02) /* median differs from the raw sample */
+#define MESH_QUALITY_STEP           (0x04) /* jump accepted after it was confirmed */
+#define MESH_QUALITY_GAP            (0x08) /* samples were dropped since the previous reading */
+
+/* sample results, not sent */
+#define MESH_FILTER_OK              (0)
+#define MESH_FILTER_READ_ERROR      (1) /* checksum or timeout, nothing to filter */
+#define MESH_FILTER_RANGE           (2) /* outside what the sensor can report */
+#define MESH_FILTER_STEP            (3) /* too far from the last reading, not confirmed yet */
+
+/*******************************************************
+ *                Structures
+ *******************************************************/
+typedef struct {
+    int16_t min;
+    int16_t max;
+    int16_t max_step;       /* largest change between two readings */
+} mesh_filter_limits_t;
+
+typedef struct {
+    uint8_t window;         /* odd, up to MESH_FILTER_WINDOW_MAX */
+    uint8_t step_confirm;   /* samples in a row that make a jump real */
+    mesh_filter_limits_t temperature;
+    mesh_filter_limits_t humidity;
+} mesh_filter_config_t;
+
+typedef struct {
+    int16_t samples[MESH_FILTER_WINDOW_MAX];
+    uint8_t count;
+    uint8_t next;
+    uint8_t step_run;
+    bool has_last;
+    int16_t last;           /* last reading passed on */
+} mesh_filter_channel_t;
+
+typedef struct {
+    uint32_t samples;
+    uint32_t passed;
+    uint32_t read_errors;
+    uint32_t range;
+    uint32_t step;
+    uint32_t smoothed;
+} mesh_filter_stats_t;
+
+typedef struct {
+    mesh_filter_config_t config;
+    mesh_filter_channel_t temperature;
+    mesh_filter_channel_t humidity;
+    uint8_t dropped;        /* since the last reading passed on, saturates */
+    mesh_filter_stats_t stats;
+} mesh_filter_t;
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+void mesh_filter_init(mesh_filter_t *filter, const mesh_filter_config_t *config);
+int mesh_filter_sample(mesh_filter_t *filter, bool read_ok, int temperature, int humidity,
+                       int *temperature_out, int *humidity_out, uint8_t *quality, uint8_t *dropped);
+
+#endif /* __MESH_FILTER_H__ */
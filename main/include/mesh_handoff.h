@@ -0,0 +1,63 @@
+/* Mesh Root Handoff
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef __MESH_HANDOFF_H__
+#define __MESH_HANDOFF_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_mesh.h"
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+/* first byte of every mesh frame, readings leave it zero */
+#define MESH_FRAME_TYPE             (0)
+#define MESH_FRAME_READING          (0x00)
+#define MESH_FRAME_HANDOFF_NODES    (0x10) /* mesh_node_state_t entries */
+#define MESH_FRAME_HANDOFF_RECORDS  (0x11) /* mesh_stream_record_t entries */
+#define MESH_FRAME_HANDOFF_DONE     (0x12) /* mesh_handoff_done_t */
+
+/*******************************************************
+ *                Structures
+ *******************************************************/
+/* <u8 type><u8 count><u16 reserved><u32 handoff id><entries> */
+typedef struct __attribute__((packed)) {
+    uint8_t type;
+    uint8_t count;
+    uint16_t reserved;
+    uint32_t id;            /* random per handoff, frames of another one are ignored */
+} mesh_handoff_hdr_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t nodes;         /* totals sent, so the new root can tell what it missed */
+    uint32_t records;
+} mesh_handoff_done_t;
+
+typedef struct {
+    uint32_t handoffs_out;
+    uint32_t nodes_sent;
+    uint32_t records_sent;
+    uint32_t send_errors;
+    uint32_t handoffs_in;
+    uint32_t nodes_received;
+    uint32_t records_received;
+    uint32_t records_missed; /* announced in DONE but never received */
+} mesh_handoff_stats_t;
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+esp_err_t mesh_handoff_start(const mesh_addr_t *new_root);
+void mesh_handoff_recv(const mesh_addr_t *from, const uint8_t *frame, int size);
+void mesh_handoff_became_root(void);
+void mesh_handoff_get_stats(mesh_handoff_stats_t *stats);
+
+#endif /* __MESH_HANDOFF_H__ */
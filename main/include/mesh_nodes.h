@@ -0,0 +1,110 @@
+/* Mesh Root Per-Node State
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef __MESH_NODES_H__
+#define __MESH_NODES_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_mesh.h"
+#include "mesh_seq.h"
+#include "sdkconfig.h"
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+/* open addressing, kept at most half full */
+#define MESH_NODES_CAPACITY      (CONFIG_MESH_ROUTE_TABLE_SIZE * 2 + 1)
+
+/* rolling windows are kept as ring buckets, so a window spans
+ * between (buckets - 1) and buckets bucket lengths of history */
+#define MESH_AGG_SHORT_BUCKETS   (5)
+#define MESH_AGG_SHORT_BUCKET_S  (60)
+#define MESH_AGG_LONG_BUCKETS    (6)
+#define MESH_AGG_LONG_BUCKET_S   (600)
+
+/*******************************************************
+ *                Structures
+ *******************************************************/
+typedef struct {
+    int32_t min;
+    int32_t max;
+    int32_t mean_x100;
+    uint32_t count;         /* readings in the window, 0 if none */
+} mesh_agg_window_t;
+
+typedef struct {
+    int32_t last;
+    int32_t ewma_x100;
+    mesh_agg_window_t short_win; /* ~5 minutes */
+    mesh_agg_window_t long_win;  /* ~1 hour */
+} mesh_metric_summary_t;
+
+typedef struct {
+    uint8_t addr[6];
+    uint8_t node_id;
+    uint8_t layer;
+    bool has_reading;       /* false while the node was only seen in other frames */
+    uint32_t last_seen_s;   /* root uptime at the last reading */
+    uint32_t age_s;
+    mesh_metric_summary_t temperature;
+    mesh_metric_summary_t humidity;
+} mesh_node_summary_t;
+
+/* where a node hangs in the mesh, as reported in its own frames */
+typedef struct {
+    uint8_t addr[6];
+    uint8_t self_ap[6];     /* softAP BSSID its children connect to */
+    uint8_t parent_ap[6];   /* softAP BSSID of its parent */
+    uint8_t layer;
+    uint32_t frames;        /* readings received, ever */
+    uint32_t age_s;
+} mesh_node_link_t;
+
+/* dedup and reading state handed from one root to the next */
+typedef struct __attribute__((packed)) {
+    uint8_t addr[6];
+    uint8_t node_id;
+    uint8_t layer;
+    uint32_t high_seq;
+    uint64_t window;
+    uint16_t session;
+    uint32_t received;
+    uint32_t lost;
+    uint32_t age_s;         /* 0xffffffff: no reading yet */
+    int16_t temperature;
+    int16_t humidity;
+    int32_t temperature_ewma; /* scaled by 256 */
+    int32_t humidity_ewma;
+} mesh_node_state_t;
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+esp_err_t mesh_nodes_init(void);
+mesh_seq_result_t mesh_nodes_check_seq(const uint8_t *addr, uint16_t session, uint32_t seq,
+                                       uint8_t layer);
+esp_err_t mesh_nodes_get_seq_stats(const uint8_t *addr, mesh_seq_stats_t *stats);
+esp_err_t mesh_nodes_get_subtree_seq_stats(const mesh_addr_t *child, mesh_seq_stats_t *stats,
+                                           int *nodes);
+esp_err_t mesh_nodes_update(const uint8_t *addr, uint8_t node_id, uint8_t layer,
+                            int temperature, int humidity);
+esp_err_t mesh_nodes_get_summary(const uint8_t *addr, mesh_node_summary_t *summary);
+int mesh_nodes_get_summaries(int start, mesh_node_summary_t *summaries, int max);
+int mesh_nodes_get_changed(int index, uint32_t *version, mesh_node_summary_t *summary);
+int mesh_nodes_get_total_seq_stats(mesh_seq_stats_t *stats);
+void mesh_nodes_note_link(const uint8_t *addr, const uint8_t *self_ap, const uint8_t *parent_ap);
+int mesh_nodes_get_links(int start, mesh_node_link_t *links, int max);
+int mesh_nodes_export(int start, mesh_node_state_t *states, int max);
+esp_err_t mesh_nodes_import(const mesh_node_state_t *state);
+void mesh_nodes_set_child(const uint8_t *addr, bool connected);
+void mesh_nodes_log_seq_stats(void);
+
+#endif /* __MESH_NODES_H__ */
@@ -0,0 +1,44 @@
+/* Mesh Adaptive Sampling Rate
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef __MESH_RATE_H__
+#define __MESH_RATE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Plain C, no ESP-IDF headers: tools/sampling_sim.py builds it on the host. */
+
+/*******************************************************
+ *                Structures
+ *******************************************************/
+typedef struct {
+    uint32_t min_interval_ms;
+    uint32_t max_interval_ms;
+    uint32_t calm_x100;     /* volatility at or below which max_interval_ms is used */
+    uint32_t busy_x100;     /* volatility at or above which min_interval_ms is used */
+} mesh_rate_config_t;
+
+typedef struct {
+    mesh_rate_config_t config;
+    bool has_last;
+    int16_t last_temperature;
+    int16_t last_humidity;
+    uint32_t volatility_x100;   /* EWMA of change per minute, C or C-equivalent */
+    uint32_t interval_ms;
+} mesh_rate_t;
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+void mesh_rate_init(mesh_rate_t *rate, const mesh_rate_config_t *config);
+uint32_t mesh_rate_update(mesh_rate_t *rate, int temperature, int humidity, uint32_t elapsed_ms,
+                          uint32_t floor_ms);
+
+#endif /* __MESH_RATE_H__ */
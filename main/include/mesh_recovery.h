@@ -0,0 +1,54 @@
+/* Mesh Recovery Tracking
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef __MESH_RECOVERY_H__
+#define __MESH_RECOVERY_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define MESH_RECOVERY_RATE_SECONDS  (10)    /* ingest baseline window */
+#define MESH_RECOVERY_PCT           (80)    /* of the baseline rate */
+#define MESH_RECOVERY_SETTLE_S      (30)    /* gaps only count once the dedup window moved on */
+#define MESH_RECOVERY_GIVE_UP_S     (600)
+
+/* mesh_recovery_track() result bits */
+#define MESH_RECOVERY_THROUGHPUT    (1 << 0)    /* ingest is back at the baseline rate */
+#define MESH_RECOVERY_SETTLED       (1 << 1)    /* the event is closed */
+
+/*******************************************************
+ *                Structures
+ *******************************************************/
+typedef struct {
+    uint32_t rx_per_s[MESH_RECOVERY_RATE_SECONDS];
+    uint32_t rx_last;
+    int slot;
+    uint32_t samples;           /* taken since the event started */
+    bool open;
+    bool connected;
+    bool throughput_back;
+    int64_t start_us;
+    int64_t connected_us;
+    uint32_t throughput_ms;
+    uint32_t baseline;          /* frames per MESH_RECOVERY_RATE_SECONDS before the event */
+} mesh_recovery_t;
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+/* Plain C with the clock passed in, also built on the host by tools/recovery_sim.py. */
+void mesh_recovery_sample(mesh_recovery_t *rec, uint32_t rx_count);
+bool mesh_recovery_start(mesh_recovery_t *rec, int64_t now_us);
+bool mesh_recovery_connected(mesh_recovery_t *rec, int64_t now_us, uint32_t *ms);
+int mesh_recovery_track(mesh_recovery_t *rec, int64_t now_us);
+
+#endif /* __MESH_RECOVERY_H__ */
@@ -0,0 +1,59 @@
+/* Mesh Sequence Dedup Window
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef __MESH_SEQ_H__
+#define __MESH_SEQ_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Plain C, no ESP-IDF headers: tools/seq_check.py builds it on the host. */
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define MESH_SEQ_WINDOW          (64)
+
+/*******************************************************
+ *                Type Definitions
+ *******************************************************/
+typedef enum {
+    MESH_SEQ_NEW = 0,       /* in order, or first frame of a node */
+    MESH_SEQ_REORDERED,     /* older than the newest seen, fills a gap */
+    MESH_SEQ_RESTART,       /* sender rebooted, new session */
+    MESH_SEQ_DUPLICATE,     /* seen before or too old to tell, drop it */
+    MESH_SEQ_UNTRACKED,     /* table full, no dedup possible */
+} mesh_seq_result_t;
+
+/*******************************************************
+ *                Structures
+ *******************************************************/
+typedef struct {
+    uint32_t received;
+    uint32_t duplicates;
+    uint32_t reordered;
+    uint32_t lost;          /* gaps that left the window unfilled */
+    uint32_t late;          /* arrived behind the window */
+    uint32_t restarts;
+} mesh_seq_stats_t;
+
+typedef struct {
+    uint32_t high_seq;
+    uint64_t window;        /* bit n set: high_seq - n was received, 0 before the first frame */
+    uint16_t session;       /* drawn by the sender at boot, its sequence starts over with it */
+} mesh_seq_window_t;
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+mesh_seq_result_t mesh_seq_check(mesh_seq_window_t *win, mesh_seq_stats_t *stats,
+                                 uint16_t session, uint32_t seq);
+void mesh_seq_merge(mesh_seq_window_t *win, const mesh_seq_window_t *other);
+
+#endif /* __MESH_SEQ_H__ */
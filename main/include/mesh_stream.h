@@ -0,0 +1,77 @@
+/* Mesh Binary Uplink Stream
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef __MESH_STREAM_H__
+#define __MESH_STREAM_H__
+
+#include <stdint.h>
+#include "esp_err.h"
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define MESH_STREAM_MAGIC        (0x5254534d) /* "MSTR" */
+#define MESH_STREAM_VERSION      (3)
+
+/* wire message types, every message is <u16 len><u8 type><body>,
+ * len counting the type byte and the body, little endian */
+#define MESH_STREAM_MSG_HELLO    (0x01) /* root -> collector */
+#define MESH_STREAM_MSG_RECORD   (0x02) /* root -> collector */
+#define MESH_STREAM_MSG_ACK      (0x81) /* collector -> root */
+
+/*******************************************************
+ *                Structures
+ *******************************************************/
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t root[6];
+    uint32_t session;       /* random per boot, sequences restart with it */
+    uint32_t tail_seq;      /* oldest record the root still holds */
+} mesh_stream_hello_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t seq;           /* stream sequence, assigned by the root */
+    uint32_t timestamp_ms;  /* root receive time, ms since boot */
+    uint8_t addr[6];        /* mesh address of the sender */
+    uint32_t node_seq;      /* sequence assigned by the sender */
+    uint16_t node_session;  /* sender boot, node_seq starts over with it */
+    uint8_t node_id;
+    uint8_t layer;
+    int8_t temperature;
+    uint8_t humidity;
+} mesh_stream_record_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t seq;           /* highest contiguous sequence stored */
+} mesh_stream_ack_t;
+
+typedef struct {
+    uint32_t pushed;
+    uint32_t sent;
+    uint32_t acked;
+    uint32_t dropped;       /* overwritten before being acknowledged */
+    uint32_t resent;        /* written again after a reconnect */
+    uint32_t connects;
+    uint32_t disconnects;
+    uint32_t writes;        /* socket writes, one per coalesced batch */
+    uint32_t handed_off;    /* given to the next root on a root switch */
+} mesh_stream_stats_t;
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+esp_err_t mesh_stream_start(void);
+esp_err_t mesh_stream_push(const uint8_t *addr, uint16_t node_session, uint32_t node_seq,
+                           uint8_t node_id, uint8_t layer, int8_t temperature, uint8_t humidity);
+int mesh_stream_take_pending(mesh_stream_record_t *records, int max);
+void mesh_stream_kick(void);
+void mesh_stream_get_stats(mesh_stream_stats_t *stats);
+
+#endif /* __MESH_STREAM_H__ */
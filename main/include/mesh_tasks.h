@@ -0,0 +1,51 @@
+/* Mesh Task Topology
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef __MESH_TASKS_H__
+#define __MESH_TASKS_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/*******************************************************
+ *                Type Definitions
+ *******************************************************/
+typedef enum {
+    MESH_TASK_RX = 0,       /* receive, dedup, aggregate, HTTP uplink */
+    MESH_TASK_TX,           /* sensor sampling and send */
+    MESH_TASK_UPLINK,       /* binary stream uplink */
+    MESH_TASK_MAX,
+} mesh_task_stage_t;
+
+/*******************************************************
+ *                Structures
+ *******************************************************/
+typedef struct {
+    int core;               /* -1: no affinity */
+    int priority;           /* current, follows the root role */
+    uint32_t runs;          /* work items: frames, samples, flushes */
+    uint32_t busy_us_max;
+    uint64_t busy_us;
+    uint32_t stack_free;    /* high water mark */
+} mesh_task_stats_t;
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+esp_err_t mesh_tasks_create(mesh_task_stage_t stage, TaskFunction_t fn, const char *name,
+                            TaskHandle_t *handle);
+void mesh_tasks_note_work(mesh_task_stage_t stage, int64_t start_us);
+void mesh_tasks_update_role(void);
+uint32_t mesh_tasks_get_role_changes(void);
+void mesh_tasks_get_stats(mesh_task_stage_t stage, mesh_task_stats_t *stats);
+
+#endif /* __MESH_TASKS_H__ */
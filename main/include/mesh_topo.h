@@ -0,0 +1,66 @@
+/* Mesh Topology Map and Subtree Balancing
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef __MESH_TOPO_H__
+#define __MESH_TOPO_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_mesh.h"
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define MESH_FRAME_REPARENT         (0x20) /* mesh_topo_reparent_t, root to node */
+
+/*******************************************************
+ *                Structures
+ *******************************************************/
+typedef struct __attribute__((packed)) {
+    uint8_t type;
+    uint8_t layer;          /* layer the node keeps after the move */
+    uint8_t bssid[6];       /* softAP of the new parent */
+} mesh_topo_reparent_t;
+
+typedef struct {
+    uint8_t addr[6];
+    uint8_t parent[6];      /* station MAC, the root's for its direct children */
+    bool parent_known;
+    uint8_t layer;
+    uint8_t children;
+    uint32_t load_x100;     /* readings per second of this node */
+    uint32_t subtree_x100;  /* same, this node and everything below it */
+} mesh_topo_node_t;
+
+typedef struct {
+    uint32_t refreshes;
+    uint32_t nodes;             /* live nodes in the map */
+    uint32_t unresolved;        /* live, parent not seen yet */
+    uint32_t root_children;
+    uint32_t max_children;      /* most children on one non-root parent */
+    uint32_t load_x100;         /* readings per second into the root */
+    uint32_t hot_subtree_x100;  /* busiest subtree below the root */
+    uint32_t moves_sent;
+    uint32_t reparents;         /* moves this node carried out */
+    uint32_t reparent_errors;
+} mesh_topo_stats_t;
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+esp_err_t mesh_topo_init(void);
+void mesh_topo_invalidate(void);
+void mesh_topo_refresh(void);
+esp_err_t mesh_topo_get_node(const uint8_t *addr, mesh_topo_node_t *node);
+void mesh_topo_recv_reparent(const mesh_addr_t *from, const uint8_t *frame, int size);
+void mesh_topo_reparent_done(void);
+void mesh_topo_get_stats(mesh_topo_stats_t *stats);
+
+#endif /* __MESH_TOPO_H__ */
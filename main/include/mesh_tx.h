@@ -0,0 +1,42 @@
+/* Mesh Non-blocking Send Path
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef __MESH_TX_H__
+#define __MESH_TX_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define MESH_TX_FRAME_MAX       (48)
+
+/*******************************************************
+ *                Structures
+ *******************************************************/
+typedef struct {
+    uint32_t sent;          /* accepted by the mesh stack */
+    uint32_t deferred;      /* queued instead of sent right away */
+    uint32_t retried;       /* sent after a failed attempt */
+    uint32_t failed;        /* send attempts refused by the mesh stack */
+    uint32_t dropped;       /* queue full or out of attempts */
+    uint32_t queued;        /* in the retry queue right now */
+    uint32_t queued_max;
+} mesh_tx_stats_t;
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+esp_err_t mesh_tx_send(const uint8_t *frame, size_t len);
+void mesh_tx_wait(uint32_t ms);
+void mesh_tx_get_stats(mesh_tx_stats_t *stats);
+
+#endif /* __MESH_TX_H__ */
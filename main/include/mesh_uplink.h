@@ -0,0 +1,52 @@
+/* Mesh HTTP Uplink
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef __MESH_UPLINK_H__
+#define __MESH_UPLINK_H__
+
+#include <stdint.h>
+#include "esp_err.h"
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+typedef enum {
+    MESH_UPLINK_CLOSED = 0,     /* posting normally */
+    MESH_UPLINK_OPEN,           /* collector failing, posts fail fast */
+    MESH_UPLINK_HALF_OPEN,      /* one probe post in flight */
+} mesh_uplink_state_t;
+
+/*******************************************************
+ *                Structures
+ *******************************************************/
+typedef struct {
+    uint32_t state;         /* mesh_uplink_state_t */
+    uint32_t requests;      /* posts sent to the collector, probes included */
+    uint32_t ok;
+    uint32_t failed;        /* transport errors and 5xx answers */
+    uint32_t slow;          /* no full answer within the deadline */
+    uint32_t rejected;      /* failed fast while open or probing */
+    uint32_t opened;
+    uint32_t probes;
+    uint32_t open_ms;       /* current open period, doubles while probes fail */
+    uint32_t retry_in_ms;   /* until the next probe while open */
+    uint32_t last_us;       /* duration of the last post */
+    uint32_t avg_us;        /* EWMA of the post duration */
+    uint32_t max_us;
+    uint32_t reject_us_max; /* longest fast fail */
+} mesh_uplink_stats_t;
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+esp_err_t mesh_uplink_post(const char *data);
+void mesh_uplink_prewarm(void);
+void mesh_uplink_get_stats(mesh_uplink_stats_t *stats);
+
+#endif /* __MESH_UPLINK_H__ */
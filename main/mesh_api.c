@@ -0,0 +1,358 @@
+/* Mesh Root Local Read API
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdarg.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_mesh.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_http_server.h"
+#include "mesh_api.h"
+#include "mesh_budget.h"
+#include "mesh_capture.h"
+#include "mesh_dlog.h"
+#include "mesh_fault.h"
+#include "mesh_handoff.h"
+#include "mesh_nodes.h"
+#include "mesh_stream.h"
+#include "mesh_tasks.h"
+#include "mesh_topo.h"
+#include "mesh_tx.h"
+#include "mesh_uplink.h"
+#include "sdkconfig.h"
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define API_NODES_PREFIX        "{\"nodes\":["
+#define API_NODES_SUFFIX        "]}"
+#define API_NODES_SIZE          (sizeof(API_NODES_PREFIX) + CONFIG_MESH_ROUTE_TABLE_SIZE * MESH_API_NODE_SLOT \
+                                 + sizeof(API_NODES_SUFFIX))
+#define API_TOPO_NODE_SIZE      (160)
+#define API_TOPO_SIZE           (192 + CONFIG_MESH_ROUTE_TABLE_SIZE * API_TOPO_NODE_SIZE)
+#define API_TOPO_MAX_AGE_US     (5 * 1000000LL)
+#define API_STATS_SIZE          (3072)
+
+/*******************************************************
+ *                Variable Definitions
+ *******************************************************/
+static const char *API_TAG = "mesh_api";
+static httpd_handle_t s_server = NULL;
+/* bodies are only touched from the httpd task, requests are served one at a time */
+static char *s_nodes_body = NULL;
+static size_t s_nodes_len = 0;
+static int s_nodes_rendered = 0;
+static uint32_t s_node_versions[CONFIG_MESH_ROUTE_TABLE_SIZE];
+static char *s_topo_body = NULL;
+static size_t s_topo_len = 0;
+static int64_t s_topo_time = 0;
+static volatile bool s_topo_dirty = true;
+static mesh_addr_t s_route_table[CONFIG_MESH_ROUTE_TABLE_SIZE];
+static uint32_t s_requests = 0;
+static uint32_t s_slots_rendered = 0;
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+static void api_render_node(int index, const mesh_node_summary_t *node)
+{
+    char *slot = s_nodes_body + sizeof(API_NODES_PREFIX) - 1 + index * MESH_API_NODE_SLOT;
+    int len = MESH_API_NODE_SLOT;
+
+    /* a node only seen in other frames has no reading yet, it gets the short form */
+    if (node->has_reading) {
+        len = snprintf(slot, MESH_API_NODE_SLOT,
+                       "%s{\"id\":%d,\"address\":\""MACSTR"\",\"layer\":%d,\"last_seen\":%u,"
+                       "\"temperature\":%d,\"temperature_ewma_x100\":%d,\"temperature_min_1h\":%d,\"temperature_max_1h\":%d,"
+                       "\"humidity\":%d,\"humidity_ewma_x100\":%d,\"humidity_min_1h\":%d,\"humidity_max_1h\":%d}",
+                       index ? "," : "", node->node_id, MAC2STR(node->addr), node->layer, node->last_seen_s,
+                       node->temperature.last, node->temperature.ewma_x100,
+                       node->temperature.long_win.min, node->temperature.long_win.max,
+                       node->humidity.last, node->humidity.ewma_x100,
+                       node->humidity.long_win.min, node->humidity.long_win.max);
+    }
+    if (len >= MESH_API_NODE_SLOT) {
+        len = snprintf(slot, MESH_API_NODE_SLOT, "%s{\"address\":\""MACSTR"\"}",
+                       index ? "," : "", MAC2STR(node->addr));
+    }
+    /* pad with whitespace, the slot keeps its width */
+    memset(slot + len, ' ', MESH_API_NODE_SLOT - len);
+    s_slots_rendered++;
+}
+
+/* Re-render only new nodes and those that got a reading since the last request. */
+static void api_refresh_nodes(void)
+{
+    mesh_node_summary_t node;
+    int i;
+
+    for (i = 0; i < CONFIG_MESH_ROUTE_TABLE_SIZE; i++) {
+        int changed = mesh_nodes_get_changed(i, &s_node_versions[i], &node);
+        if (changed < 0) {
+            break;
+        }
+        if (changed) {
+            api_render_node(i, &node);
+        }
+    }
+    if (i != s_nodes_rendered || !s_nodes_len) {
+        s_nodes_rendered = i;
+        s_nodes_len = sizeof(API_NODES_PREFIX) - 1 + i * MESH_API_NODE_SLOT;
+        memcpy(s_nodes_body + s_nodes_len, API_NODES_SUFFIX, sizeof(API_NODES_SUFFIX));
+        s_nodes_len += sizeof(API_NODES_SUFFIX) - 1;
+    }
+}
+
+static void api_refresh_topology(void)
+{
+    mesh_addr_t self;
+    mesh_addr_t parent = { 0, };
+    mesh_topo_node_t node;
+    mesh_topo_stats_t topo;
+    int size = 0;
+
+    if (!s_topo_dirty && esp_timer_get_time() - s_topo_time < API_TOPO_MAX_AGE_US) {
+        return;
+    }
+    s_topo_dirty = false;
+    s_topo_time = esp_timer_get_time();
+
+    esp_read_mac(self.addr, ESP_MAC_WIFI_STA);
+    esp_mesh_get_parent_bssid(&parent);
+    esp_mesh_get_routing_table(s_route_table, CONFIG_MESH_ROUTE_TABLE_SIZE * 6, &size);
+    mesh_topo_refresh();
+    mesh_topo_get_stats(&topo);
+    int len = snprintf(s_topo_body, API_TOPO_SIZE,
+                       "{\"self\":\""MACSTR"\",\"root\":%s,\"layer\":%d,\"parent\":\""MACSTR"\",\"size\":%d,"
+                       "\"children\":%u,\"load_x100\":%u,\"nodes\":[",
+                       MAC2STR(self.addr), esp_mesh_is_root() ? "true" : "false", esp_mesh_get_layer(),
+                       MAC2STR(parent.addr), size, topo.root_children, topo.load_x100);
+    for (int i = 0; i < size && len < API_TOPO_SIZE; i++) {
+        if (mesh_topo_get_node(s_route_table[i].addr, &node) != ESP_OK) {
+            len += snprintf(s_topo_body + len, API_TOPO_SIZE - len, "%s{\"address\":\""MACSTR"\",\"layer\":-1}",
+                            i ? "," : "", MAC2STR(s_route_table[i].addr));
+            continue;
+        }
+        char parent_str[20] = "null";
+        if (node.parent_known) {
+            snprintf(parent_str, sizeof(parent_str), "\""MACSTR"\"", MAC2STR(node.parent));
+        }
+        len += snprintf(s_topo_body + len, API_TOPO_SIZE - len,
+                        "%s{\"address\":\""MACSTR"\",\"layer\":%d,\"parent\":%s,\"children\":%d,"
+                        "\"load_x100\":%u,\"subtree_x100\":%u}",
+                        i ? "," : "", MAC2STR(node.addr), node.layer, parent_str, node.children,
+                        node.load_x100, node.subtree_x100);
+    }
+    if (len < API_TOPO_SIZE) {
+        len += snprintf(s_topo_body + len, API_TOPO_SIZE - len, "]}");
+    }
+    s_topo_len = len < API_TOPO_SIZE ? len : API_TOPO_SIZE - 1;
+}
+
+static esp_err_t api_nodes_get(httpd_req_t *req)
+{
+    s_requests++;
+    api_refresh_nodes();
+    httpd_resp_set_type(req, "application/json");
+    return httpd_resp_send(req, s_nodes_body, s_nodes_len);
+}
+
+static esp_err_t api_topology_get(httpd_req_t *req)
+{
+    s_requests++;
+    api_refresh_topology();
+    httpd_resp_set_type(req, "application/json");
+    return httpd_resp_send(req, s_topo_body, s_topo_len);
+}
+
+/* snprintf at body + len that never moves len past size, so every later append stays in bounds */
+static int __attribute__((format(printf, 4, 5))) api_append(char *body, int size, int len,
+                                                             const char *fmt, ...)
+{
+    va_list args;
+
+    if (len >= size) {
+        return size;
+    }
+    va_start(args, fmt);
+    int n = vsnprintf(body + len, size - len, fmt, args);
+    va_end(args);
+    return n < 0 || n >= size - len ? size : len + n;
+}
+
+static esp_err_t api_stats_get(httpd_req_t *req)
+{
+    /* changes every call, cheaper to render than to track; static to spare the httpd stack */
+    static char body[API_STATS_SIZE];
+    mesh_seq_stats_t seq;
+
+    s_requests++;
+    int nodes = mesh_nodes_get_total_seq_stats(&seq);
+    int len = api_append(body, sizeof(body), 0,
+                         "{\"uptime\":%u,\"heap\":%u,\"heap_min\":%u,\"nodes\":%d,"
+                         "\"received\":%u,\"duplicates\":%u,\"reordered\":%u,\"lost\":%u,\"late\":%u,\"restarts\":%u,"
+                         "\"api_requests\":%u,\"api_slots_rendered\":%u",
+                         (uint32_t)(esp_timer_get_time() / 1000000), esp_get_free_heap_size(),
+                         esp_get_minimum_free_heap_size(), nodes,
+                         seq.received, seq.duplicates, seq.reordered, seq.lost, seq.late, seq.restarts,
+                         s_requests, s_slots_rendered);
+#if CONFIG_MESH_UPLINK_STREAM
+    mesh_stream_stats_t stream;
+    mesh_stream_get_stats(&stream);
+    len = api_append(body, sizeof(body), len,
+                     ",\"stream\":{\"pushed\":%u,\"sent\":%u,\"acked\":%u,\"dropped\":%u,\"resent\":%u,"
+                     "\"connects\":%u,\"writes\":%u,\"handed_off\":%u}",
+                     stream.pushed, stream.sent, stream.acked, stream.dropped, stream.resent,
+                     stream.connects, stream.writes, stream.handed_off);
+#elif CONFIG_MESH_UPLINK_HTTP
+    static const char *uplink_states[] = { "closed", "open", "half_open" };
+    mesh_uplink_stats_t uplink;
+    mesh_uplink_get_stats(&uplink);
+    len = api_append(body, sizeof(body), len,
+                     ",\"uplink\":{\"state\":\"%s\",\"requests\":%u,\"ok\":%u,\"failed\":%u,"
+                     "\"slow\":%u,\"rejected\":%u,\"opened\":%u,\"probes\":%u,\"open_ms\":%u,"
+                     "\"retry_in_ms\":%u,\"last_us\":%u,\"avg_us\":%u,\"max_us\":%u,"
+                     "\"reject_us_max\":%u}",
+                     uplink_states[uplink.state], uplink.requests, uplink.ok, uplink.failed,
+                     uplink.slow, uplink.rejected, uplink.opened, uplink.probes, uplink.open_ms,
+                     uplink.retry_in_ms, uplink.last_us, uplink.avg_us, uplink.max_us,
+                     uplink.reject_us_max);
+#endif
+    mesh_fault_stats_t fault;
+    mesh_fault_get_stats(&fault);
+    len = api_append(body, sizeof(body), len,
+                     ",\"faults\":{\"events\":%u,\"injected\":%u,\"connect_ms_max\":%u,\"connect_ms_avg\":%u,"
+                     "\"throughput_ms_max\":%u,\"throughput_ms_avg\":%u,\"lost\":%u,\"heap_drift\":%d,"
+                     "\"root_switches\":%u,\"root_switch_lost\":%u}",
+                     fault.events, fault.injected, fault.connect_ms_max,
+                     fault.events ? fault.connect_ms_sum / fault.events : 0,
+                     fault.throughput_ms_max,
+                     fault.throughput_samples ? fault.throughput_ms_sum / fault.throughput_samples : 0,
+                     fault.lost, (int)fault.heap_now - (int)fault.heap_start,
+                     fault.root_switches, fault.root_switch_lost);
+    mesh_handoff_stats_t handoff;
+    mesh_handoff_get_stats(&handoff);
+    len = api_append(body, sizeof(body), len,
+                     ",\"handoff\":{\"out\":%u,\"nodes_sent\":%u,\"records_sent\":%u,\"send_errors\":%u,"
+                     "\"in\":%u,\"nodes_received\":%u,\"records_received\":%u,\"records_missed\":%u}",
+                     handoff.handoffs_out, handoff.nodes_sent, handoff.records_sent, handoff.send_errors,
+                     handoff.handoffs_in, handoff.nodes_received, handoff.records_received,
+                     handoff.records_missed);
+    mesh_tx_stats_t tx;
+    mesh_tx_get_stats(&tx);
+    len = api_append(body, sizeof(body), len,
+                     ",\"tx\":{\"sent\":%u,\"deferred\":%u,\"retried\":%u,\"failed\":%u,\"dropped\":%u,"
+                     "\"queued\":%u,\"queued_max\":%u}",
+                     tx.sent, tx.deferred, tx.retried, tx.failed, tx.dropped, tx.queued, tx.queued_max);
+    mesh_topo_stats_t topo;
+    mesh_topo_get_stats(&topo);
+    len = api_append(body, sizeof(body), len,
+                     ",\"topo\":{\"refreshes\":%u,\"nodes\":%u,\"unresolved\":%u,\"root_children\":%u,"
+                     "\"max_children\":%u,\"load_x100\":%u,\"hot_subtree_x100\":%u,\"moves_sent\":%u,"
+                     "\"reparents\":%u,\"reparent_errors\":%u}",
+                     topo.refreshes, topo.nodes, topo.unresolved, topo.root_children, topo.max_children,
+                     topo.load_x100, topo.hot_subtree_x100, topo.moves_sent, topo.reparents,
+                     topo.reparent_errors);
+    mesh_budget_stats_t budget;
+    mesh_budget_get_stats(&budget);
+    len = api_append(body, sizeof(body), len,
+                     ",\"budget\":{\"budget_x100\":%u,\"load_x100\":%u,\"floor_ms\":%u,"
+                     "\"adjustments\":%u,\"announced\":%u,\"send_errors\":%u,\"received\":%u}",
+                     budget.budget_x100, budget.load_x100, budget.floor_ms, budget.adjustments,
+                     budget.announced, budget.send_errors, budget.received);
+    static const char *stage_names[MESH_TASK_MAX] = { "rx", "tx", "uplink" };
+    len = api_append(body, sizeof(body), len, ",\"tasks\":{\"role_changes\":%u",
+                     mesh_tasks_get_role_changes());
+    for (int i = 0; i < MESH_TASK_MAX; i++) {
+        mesh_task_stats_t task;
+        mesh_tasks_get_stats(i, &task);
+        len = api_append(body, sizeof(body), len,
+                         ",\"%s\":{\"core\":%d,\"prio\":%d,\"runs\":%u,\"busy_us\":%llu,\"busy_us_max\":%u,"
+                         "\"stack_free\":%u}",
+                         stage_names[i], task.core, task.priority, task.runs,
+                         (unsigned long long)task.busy_us, task.busy_us_max, task.stack_free);
+    }
+    len = api_append(body, sizeof(body), len, "}");
+#if CONFIG_MESH_CAPTURE
+    mesh_capture_stats_t capture;
+    mesh_capture_get_stats(&capture);
+    len = api_append(body, sizeof(body), len,
+                     ",\"capture\":{\"captured\":%u,\"dropped\":%u,\"sent\":%u,\"bytes\":%u,"
+                     "\"connects\":%u,\"used_max\":%u}",
+                     capture.captured, capture.dropped, capture.sent, capture.bytes,
+                     capture.connects, capture.used_max);
+#endif
+#if CONFIG_MESH_DLOG
+    mesh_dlog_stats_t dlog;
+    mesh_dlog_get_stats(&dlog);
+    len = api_append(body, sizeof(body), len,
+                     ",\"dlog\":{\"records\":%u,\"dropped\":%u,\"flushed\":%u,\"words_max\":%u}",
+                     dlog.records, dlog.dropped, dlog.flushed, dlog.words_max);
+#endif
+    len = api_append(body, sizeof(body), len, "}");
+    if (len >= API_STATS_SIZE) {
+        /* a cut off object is not JSON, better no answer than a wrong one */
+        ESP_LOGE(API_TAG, "/stats does not fit in %d bytes", API_STATS_SIZE);
+        return httpd_resp_send_500(req);
+    }
+    httpd_resp_set_type(req, "application/json");
+    return httpd_resp_send(req, body, len);
+}
+
+static const httpd_uri_t s_api_uris[] = {
+    { .uri = "/nodes",    .method = HTTP_GET, .handler = api_nodes_get,    .user_ctx = NULL },
+    { .uri = "/topology", .method = HTTP_GET, .handler = api_topology_get, .user_ctx = NULL },
+    { .uri = "/stats",    .method = HTTP_GET, .handler = api_stats_get,    .user_ctx = NULL },
+};
+
+void mesh_api_invalidate_topology(void)
+{
+    s_topo_dirty = true;
+}
+
+esp_err_t mesh_api_start(void)
+{
+    if (s_server) {
+        return ESP_OK;
+    }
+    if (!s_nodes_body) {
+        s_nodes_body = calloc(1, API_NODES_SIZE);
+        s_topo_body = calloc(1, API_TOPO_SIZE);
+        if (!s_nodes_body || !s_topo_body) {
+            free(s_nodes_body);
+            free(s_topo_body);
+            s_nodes_body = NULL;
+            s_topo_body = NULL;
+            return ESP_ERR_NO_MEM;
+        }
+        memcpy(s_nodes_body, API_NODES_PREFIX, sizeof(API_NODES_PREFIX) - 1);
+        /* no version is rendered yet, so every entry is rendered on its first request */
+        memset(s_node_versions, 0xff, sizeof(s_node_versions));
+    }
+
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.server_port = CONFIG_MESH_LOCAL_API_PORT;
+    /* dashboards poll, drop the oldest idle connection instead of refusing */
+    config.lru_purge_enable = true;
+    esp_err_t err = httpd_start(&s_server, &config);
+    if (err != ESP_OK) {
+        ESP_LOGE(API_TAG, "httpd_start failed: %s", esp_err_to_name(err));
+        s_server = NULL;
+        return err;
+    }
+    for (int i = 0; i < sizeof(s_api_uris) / sizeof(s_api_uris[0]); i++) {
+        httpd_register_uri_handler(s_server, &s_api_uris[i]);
+    }
+    ESP_LOGI(API_TAG, "local API on port %d", CONFIG_MESH_LOCAL_API_PORT);
+    return ESP_OK;
+}
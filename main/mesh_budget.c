@@ -0,0 +1,174 @@
+/* Mesh Reading Rate Budget
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <string.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_mesh.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "mesh_budget.h"
+#include "mesh_topo.h"
+#include "sdkconfig.h"
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define BUDGET_PERIOD_MS        (CONFIG_MESH_RATE_BUDGET_PERIOD_S * 1000)
+#define BUDGET_ANNOUNCE_EVERY   (6)     /* periods, so nodes that joined late learn the floor */
+#define BUDGET_EXPIRE_US        (3LL * BUDGET_ANNOUNCE_EVERY * BUDGET_PERIOD_MS * 1000)
+#define BUDGET_LOW_PCT          (80)    /* relax the floor below this share of the budget */
+#if CONFIG_MESH_ROOT_CAPABLE
+#define BUDGET_X100             (CONFIG_MESH_RATE_BUDGET_X100)
+#else
+#define BUDGET_X100             (0)     /* never root, only follows the floor */
+#endif
+
+/*******************************************************
+ *                Variable Definitions
+ *******************************************************/
+static const char *BUDGET_TAG = "mesh_budget";
+static volatile uint32_t s_floor_ms = 0;
+static volatile int64_t s_floor_us = 0;     /* when the floor was last set */
+static mesh_budget_stats_t s_stats;
+#if BUDGET_X100
+static mesh_addr_t s_route_table[CONFIG_MESH_ROUTE_TABLE_SIZE];
+#endif
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+static void budget_set_floor(uint32_t floor_ms)
+{
+    s_floor_ms = floor_ms;
+    s_floor_us = esp_timer_get_time();
+}
+
+uint32_t mesh_budget_floor_ms(void)
+{
+    /* a floor from a root that is gone no longer holds */
+    if (s_floor_ms && esp_timer_get_time() - s_floor_us > BUDGET_EXPIRE_US) {
+        s_floor_ms = 0;
+    }
+    return s_floor_ms;
+}
+
+void mesh_budget_recv(const mesh_addr_t *from, const uint8_t *frame, int size)
+{
+    mesh_budget_floor_t msg;
+
+    if (size < sizeof(msg) || esp_mesh_is_root()) {
+        return;
+    }
+    memcpy(&msg, frame, sizeof(msg));
+    if (msg.floor_ms != s_floor_ms) {
+        ESP_LOGI(BUDGET_TAG, "floor %ums from "MACSTR"", msg.floor_ms, MAC2STR(from->addr));
+    }
+    budget_set_floor(msg.floor_ms);
+    s_stats.received++;
+}
+
+#if BUDGET_X100
+static void budget_announce(uint32_t floor_ms)
+{
+    mesh_budget_floor_t msg = {
+        .type = MESH_FRAME_RATE_FLOOR,
+        .floor_ms = floor_ms,
+    };
+    mesh_data_t data = {
+        .data = (uint8_t *)&msg,
+        .size = sizeof(msg),
+        .proto = MESH_PROTO_BIN,
+        .tos = MESH_TOS_P2P,
+    };
+    uint8_t self[6];
+    int size = 0;
+
+    esp_read_mac(self, ESP_MAC_WIFI_STA);
+    esp_mesh_get_routing_table(s_route_table, CONFIG_MESH_ROUTE_TABLE_SIZE * 6, &size);
+    for (int i = 0; i < size; i++) {
+        if (!memcmp(s_route_table[i].addr, self, sizeof(self))) {
+            continue;
+        }
+        if (esp_mesh_send(&s_route_table[i], &data, MESH_DATA_P2P, NULL, 0) != ESP_OK) {
+            s_stats.send_errors++;
+            continue;
+        }
+        s_stats.announced++;
+    }
+}
+
+/* Stretch the floor in proportion to the overshoot, relax it by a fifth once
+ * the load is well under budget. Calm nodes already run slower than the floor,
+ * so it only slows the busy ones. */
+static uint32_t budget_next_floor(uint32_t floor_ms, uint32_t load_x100)
+{
+    uint32_t budget = BUDGET_X100;
+
+    if (load_x100 > budget) {
+        uint32_t base = floor_ms > CONFIG_MESH_RATE_MIN_INTERVAL_MS ? floor_ms : CONFIG_MESH_RATE_MIN_INTERVAL_MS;
+        floor_ms = (uint64_t)base * load_x100 / budget;
+        return floor_ms < CONFIG_MESH_RATE_MAX_INTERVAL_MS ? floor_ms : CONFIG_MESH_RATE_MAX_INTERVAL_MS;
+    }
+    if (floor_ms && load_x100 * 100 < budget * BUDGET_LOW_PCT) {
+        floor_ms = floor_ms * 4 / 5;
+        return floor_ms > CONFIG_MESH_RATE_MIN_INTERVAL_MS ? floor_ms : 0;
+    }
+    return floor_ms;
+}
+
+static void mesh_budget_task(void *arg)
+{
+    mesh_topo_stats_t topo;
+    int periods = 0;
+
+    while (true) {
+        vTaskDelay(BUDGET_PERIOD_MS / portTICK_PERIOD_MS);
+        if (!esp_mesh_is_root()) {
+            periods = 0;
+            continue;
+        }
+        mesh_topo_refresh();
+        mesh_topo_get_stats(&topo);
+        s_stats.load_x100 = topo.load_x100;
+
+        uint32_t floor_ms = budget_next_floor(s_floor_ms, topo.load_x100);
+        bool changed = floor_ms != s_floor_ms;
+        budget_set_floor(floor_ms);
+        if (changed) {
+            s_stats.adjustments++;
+            ESP_LOGW(BUDGET_TAG, "load %u.%02u/s budget %u.%02u/s, floor %ums",
+                     topo.load_x100 / 100, topo.load_x100 % 100,
+                     BUDGET_X100 / 100, BUDGET_X100 % 100, floor_ms);
+        }
+        if (changed || !(periods++ % BUDGET_ANNOUNCE_EVERY)) {
+            budget_announce(floor_ms);
+        }
+    }
+}
+#endif
+
+void mesh_budget_get_stats(mesh_budget_stats_t *stats)
+{
+    *stats = s_stats;
+    stats->budget_x100 = BUDGET_X100;
+    stats->floor_ms = mesh_budget_floor_ms();
+}
+
+esp_err_t mesh_budget_start(void)
+{
+#if BUDGET_X100
+    if (xTaskCreate(mesh_budget_task, "MBDG", 3072, NULL, 2, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+#endif
+    return ESP_OK;
+}
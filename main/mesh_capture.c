@@ -0,0 +1,264 @@
+/* Mesh Root Ingress Capture
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_mesh.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "lwip/sockets.h"
+#include "lwip/netdb.h"
+#include "mesh_capture.h"
+#include "sdkconfig.h"
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define CAPTURE_RING_SIZE       (CONFIG_MESH_CAPTURE_RING_SIZE)
+#define CAPTURE_SNAPLEN         (CONFIG_MESH_CAPTURE_SNAPLEN)
+#define CAPTURE_REC_MAX         (sizeof(mesh_capture_rec_t) + CAPTURE_SNAPLEN)
+#define CAPTURE_CHUNK_SIZE      (CAPTURE_REC_MAX > 1024 ? CAPTURE_REC_MAX : 1024)  /* fits the largest record */
+#define CAPTURE_FLUSH_MS        (200)
+#define CAPTURE_IO_TIMEOUT_S    (5)
+#define CAPTURE_BACKOFF_MIN_MS  (1000)
+#define CAPTURE_BACKOFF_MAX_MS  (30000)
+
+/*******************************************************
+ *                Variable Definitions
+ *******************************************************/
+static const char *CAPTURE_TAG = "mesh_capture";
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+/* whole records back to back, wrapping; head and tail only grow */
+static uint8_t s_ring[CAPTURE_RING_SIZE];
+static uint32_t s_head = 0;
+static uint32_t s_tail = 0;
+static uint32_t s_pending_drops = 0;
+static uint8_t s_chunk[CAPTURE_CHUNK_SIZE];
+static uint32_t s_session = 0;
+static TaskHandle_t s_task = NULL;
+static volatile bool s_connected = false;
+static mesh_capture_stats_t s_stats;
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+static void ring_write(uint32_t pos, const void *src, size_t len)
+{
+    size_t off = pos % CAPTURE_RING_SIZE;
+    size_t first = len < CAPTURE_RING_SIZE - off ? len : CAPTURE_RING_SIZE - off;
+
+    memcpy(s_ring + off, src, first);
+    memcpy(s_ring, (const uint8_t *)src + first, len - first);
+}
+
+static void ring_read(uint32_t pos, void *dst, size_t len)
+{
+    size_t off = pos % CAPTURE_RING_SIZE;
+    size_t first = len < CAPTURE_RING_SIZE - off ? len : CAPTURE_RING_SIZE - off;
+
+    memcpy(dst, s_ring + off, first);
+    memcpy((uint8_t *)dst + first, s_ring, len - first);
+}
+
+/* Called from the rx task for every frame, only copies. */
+void mesh_capture_frame(const mesh_addr_t *from, const uint8_t *frame, int size, int flag)
+{
+    int64_t now_us = esp_timer_get_time();
+    mesh_capture_rec_t rec = {
+        .time_ms = (uint32_t)(now_us / 1000),
+        .time_us = (uint16_t)(now_us % 1000),
+        .flag = flag,
+        .size = size,
+        .caplen = size < CAPTURE_SNAPLEN ? size : CAPTURE_SNAPLEN,
+    };
+    bool kick = false;
+
+    if (!s_task || !s_connected) {
+        return;
+    }
+    memcpy(rec.from, from->addr, sizeof(rec.from));
+
+    portENTER_CRITICAL(&s_mux);
+    uint32_t used = s_head - s_tail;
+    if (used + sizeof(rec) + rec.caplen > CAPTURE_RING_SIZE) {
+        s_pending_drops++;
+        s_stats.dropped++;
+    } else {
+        rec.dropped = s_pending_drops > UINT16_MAX ? UINT16_MAX : s_pending_drops;
+        s_pending_drops = 0;
+        ring_write(s_head, &rec, sizeof(rec));
+        ring_write(s_head + sizeof(rec), frame, rec.caplen);
+        s_head += sizeof(rec) + rec.caplen;
+        used += sizeof(rec) + rec.caplen;
+        s_stats.captured++;
+        if (used > s_stats.used_max) {
+            s_stats.used_max = used;
+        }
+        kick = used >= CAPTURE_RING_SIZE / 2;
+    }
+    portEXIT_CRITICAL(&s_mux);
+
+    if (kick) {
+        xTaskNotifyGive(s_task);
+    }
+}
+
+/* Take whole records only, a partial one would desync the next connection. */
+static size_t capture_take(int *records)
+{
+    mesh_capture_rec_t rec;
+    size_t len = 0;
+
+    *records = 0;
+    portENTER_CRITICAL(&s_mux);
+    while (s_head - s_tail >= sizeof(rec)) {
+        ring_read(s_tail, &rec, sizeof(rec));
+        size_t rec_len = sizeof(rec) + rec.caplen;
+        if (len + rec_len > sizeof(s_chunk)) {
+            break;
+        }
+        ring_read(s_tail, s_chunk + len, rec_len);
+        s_tail += rec_len;
+        len += rec_len;
+        (*records)++;
+    }
+    portEXIT_CRITICAL(&s_mux);
+    return len;
+}
+
+static esp_err_t capture_send_all(int sock, const uint8_t *buf, size_t len)
+{
+    while (len) {
+        int n = send(sock, buf, len, 0);
+        if (n < 0) {
+            ESP_LOGE(CAPTURE_TAG, "send failed, errno:%d", errno);
+            return ESP_FAIL;
+        }
+        buf += n;
+        len -= n;
+    }
+    return ESP_OK;
+}
+
+static int capture_connect(void)
+{
+    struct addrinfo hints = {
+        .ai_family = AF_INET,
+        .ai_socktype = SOCK_STREAM,
+    };
+    struct addrinfo *res = NULL;
+    char port[8];
+
+    snprintf(port, sizeof(port), "%d", CONFIG_MESH_CAPTURE_PORT);
+    if (getaddrinfo(CONFIG_MESH_CAPTURE_HOST, port, &hints, &res) != 0 || !res) {
+        ESP_LOGE(CAPTURE_TAG, "cannot resolve %s", CONFIG_MESH_CAPTURE_HOST);
+        return -1;
+    }
+    int sock = socket(res->ai_family, res->ai_socktype, 0);
+    if (sock < 0) {
+        freeaddrinfo(res);
+        return -1;
+    }
+    struct timeval tv = { .tv_sec = CAPTURE_IO_TIMEOUT_S, .tv_usec = 0 };
+    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    if (connect(sock, res->ai_addr, res->ai_addrlen) != 0) {
+        ESP_LOGE(CAPTURE_TAG, "connect to %s:%s failed, errno:%d",
+                 CONFIG_MESH_CAPTURE_HOST, port, errno);
+        freeaddrinfo(res);
+        close(sock);
+        return -1;
+    }
+    freeaddrinfo(res);
+
+    mesh_capture_hdr_t hdr = {
+        .magic = MESH_CAPTURE_MAGIC,
+        .version = MESH_CAPTURE_VERSION,
+        .snaplen = CAPTURE_SNAPLEN,
+        .session = s_session,
+    };
+    esp_read_mac(hdr.root, ESP_MAC_WIFI_STA);
+    if (capture_send_all(sock, (const uint8_t *)&hdr, sizeof(hdr)) != ESP_OK) {
+        close(sock);
+        return -1;
+    }
+    ESP_LOGI(CAPTURE_TAG, "capturing to %s:%s", CONFIG_MESH_CAPTURE_HOST, port);
+    return sock;
+}
+
+static void mesh_capture_task(void *arg)
+{
+    uint32_t backoff_ms = CAPTURE_BACKOFF_MIN_MS;
+    int records;
+
+    while (true) {
+        if (!esp_mesh_is_root()) {
+            ulTaskNotifyTake(pdTRUE, 1000 / portTICK_PERIOD_MS);
+            continue;
+        }
+        int sock = capture_connect();
+        if (sock < 0) {
+            vTaskDelay((backoff_ms + esp_random() % backoff_ms) / portTICK_PERIOD_MS);
+            backoff_ms = backoff_ms * 2 > CAPTURE_BACKOFF_MAX_MS ? CAPTURE_BACKOFF_MAX_MS : backoff_ms * 2;
+            continue;
+        }
+        backoff_ms = CAPTURE_BACKOFF_MIN_MS;
+        s_stats.connects++;
+        /* frames are only kept while someone is listening */
+        s_connected = true;
+
+        while (esp_mesh_is_root()) {
+            ulTaskNotifyTake(pdTRUE, CAPTURE_FLUSH_MS / portTICK_PERIOD_MS);
+            size_t len;
+            esp_err_t err = ESP_OK;
+            while (err == ESP_OK && (len = capture_take(&records)) > 0) {
+                err = capture_send_all(sock, s_chunk, len);
+                if (err == ESP_OK) {
+                    s_stats.sent += records;
+                    s_stats.bytes += len;
+                }
+            }
+            if (err != ESP_OK) {
+                break;
+            }
+        }
+        s_connected = false;
+        close(sock);
+
+        /* start the next connection on a record boundary with fresh data */
+        portENTER_CRITICAL(&s_mux);
+        s_tail = s_head;
+        s_pending_drops = 0;
+        portEXIT_CRITICAL(&s_mux);
+    }
+}
+
+void mesh_capture_get_stats(mesh_capture_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_mux);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_mux);
+}
+
+esp_err_t mesh_capture_start(void)
+{
+    if (s_task) {
+        return ESP_OK;
+    }
+    s_session = esp_random();
+    if (xTaskCreate(mesh_capture_task, "MCAP", 3072, NULL, 2, &s_task) != pdPASS) {
+        s_task = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,164 @@
+/* Mesh Deferred Binary Log
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_mesh.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "mesh_dlog.h"
+#include "sdkconfig.h"
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define DLOG_RING_WORDS         (CONFIG_MESH_DLOG_RING_WORDS)
+#define DLOG_HDR_WORDS          (4) /* fmt, tag, timestamp ms, level << 8 | nargs */
+#define DLOG_FLUSH_MS           (50)
+#define DLOG_BENCH_CALLS        (64)
+#define DLOG_BENCH_BATCH        (16)
+
+/*******************************************************
+ *                Variable Definitions
+ *******************************************************/
+static const char *DLOG_TAG = "mesh_dlog";
+static uint32_t s_ring[DLOG_RING_WORDS];
+static volatile uint32_t s_head = 0;    /* words written, wraps */
+static volatile uint32_t s_tail = 0;    /* words flushed, wraps */
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+static mesh_dlog_stats_t s_stats;
+static TaskHandle_t s_task = NULL;
+static char s_line[sizeof(MESH_DLOG_LINE_PREFIX) + (DLOG_HDR_WORDS + MESH_DLOG_MAX_ARGS) * 8 + 1];
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+void mesh_dlog_write(int level, const char *tag, const char *fmt, int nargs, const uint32_t *args)
+{
+    uint32_t timestamp = esp_log_timestamp();
+
+    if (nargs > MESH_DLOG_MAX_ARGS) {
+        nargs = MESH_DLOG_MAX_ARGS;
+    }
+    uint32_t words = DLOG_HDR_WORDS + nargs;
+    portENTER_CRITICAL(&s_mux);
+    uint32_t used = s_head - s_tail;
+    if (!s_task || used + words > DLOG_RING_WORDS) {
+        s_stats.dropped++;
+        portEXIT_CRITICAL(&s_mux);
+        return;
+    }
+    uint32_t head = s_head;
+    s_ring[head++ % DLOG_RING_WORDS] = (uint32_t)(uintptr_t)fmt;
+    s_ring[head++ % DLOG_RING_WORDS] = (uint32_t)(uintptr_t)tag;
+    s_ring[head++ % DLOG_RING_WORDS] = timestamp;
+    s_ring[head++ % DLOG_RING_WORDS] = (level << 8) | nargs;
+    for (int i = 0; i < nargs; i++) {
+        s_ring[head++ % DLOG_RING_WORDS] = args[i];
+    }
+    s_head = head;
+    s_stats.records++;
+    if (used + words > s_stats.words_max) {
+        s_stats.words_max = used + words;
+    }
+    portEXIT_CRITICAL(&s_mux);
+}
+
+static char *dlog_hex(char *out, uint32_t word)
+{
+    static const char digits[] = "0123456789abcdef";
+    for (int shift = 28; shift >= 0; shift -= 4) {
+        *out++ = digits[(word >> shift) & 0xf];
+    }
+    return out;
+}
+
+/* Only this task moves the tail, writers never touch words behind the head. */
+static void mesh_dlog_task(void *arg)
+{
+    uint32_t dropped = 0;
+
+    while (true) {
+        vTaskDelay(DLOG_FLUSH_MS / portTICK_PERIOD_MS);
+        portENTER_CRITICAL(&s_mux);
+        uint32_t head = s_head;
+        portEXIT_CRITICAL(&s_mux);
+
+        uint32_t tail = s_tail;
+        while (tail != head) {
+            uint32_t words = DLOG_HDR_WORDS + (s_ring[(tail + 3) % DLOG_RING_WORDS] & 0xff);
+            char *p = s_line;
+            memcpy(p, MESH_DLOG_LINE_PREFIX, sizeof(MESH_DLOG_LINE_PREFIX) - 1);
+            p += sizeof(MESH_DLOG_LINE_PREFIX) - 1;
+            for (uint32_t i = 0; i < words; i++) {
+                p = dlog_hex(p, s_ring[tail++ % DLOG_RING_WORDS]);
+            }
+            *p++ = '\n';
+            fwrite(s_line, 1, p - s_line, stdout);
+            portENTER_CRITICAL(&s_mux);
+            s_tail = tail;
+            s_stats.flushed++;
+            portEXIT_CRITICAL(&s_mux);
+        }
+        fflush(stdout);
+        if (s_stats.dropped != dropped) {
+            ESP_LOGW(DLOG_TAG, "%u records dropped, ring full", s_stats.dropped - dropped);
+            dropped = s_stats.dropped;
+        }
+    }
+}
+
+void mesh_dlog_get_stats(mesh_dlog_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_mux);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_mux);
+}
+
+/* Per-call cost of the root's per-frame log line, formatted vs deferred. */
+void mesh_dlog_benchmark(void)
+{
+    static const uint8_t addr[6] = { 0x24, 0x0a, 0xc4, 0x12, 0x34, 0x56 };
+    int64_t text_us = 0;
+    int64_t deferred_us = 0;
+
+    for (int i = 0; i < DLOG_BENCH_CALLS; i++) {
+        int64_t start = esp_timer_get_time();
+        ESP_LOGW(DLOG_TAG, "[#RX:id %d seq %u Temperature %d Humidity %d][L:%d] parent:"MACSTR", receive from "MACSTR", size:%d, heap:%d",
+                 1, i, 24, 60, 2, MAC2STR(addr), MAC2STR(addr), 30, 100000);
+        text_us += esp_timer_get_time() - start;
+    }
+    for (int i = 0; i < DLOG_BENCH_CALLS; i++) {
+        /* let the flush task keep up, a full ring would measure the drop path */
+        if (!(i % DLOG_BENCH_BATCH)) {
+            vTaskDelay(2 * DLOG_FLUSH_MS / portTICK_PERIOD_MS);
+        }
+        int64_t start = esp_timer_get_time();
+        MESH_DLOGW(DLOG_TAG, "[#RX:id %d seq %u Temperature %d Humidity %d][L:%d] parent:"MACSTR", receive from "MACSTR", size:%d, heap:%d",
+                   1, i, 24, 60, 2, MAC2STR(addr), MAC2STR(addr), 30, 100000);
+        deferred_us += esp_timer_get_time() - start;
+    }
+    ESP_LOGW(DLOG_TAG, "per call over %d calls: ESP_LOGW %dus, MESH_DLOGW %dus", DLOG_BENCH_CALLS,
+             (int)(text_us / DLOG_BENCH_CALLS), (int)(deferred_us / DLOG_BENCH_CALLS));
+}
+
+esp_err_t mesh_dlog_init(void)
+{
+    if (s_task) {
+        return ESP_OK;
+    }
+    /* lowest application priority, logs go out when nothing else runs */
+    if (xTaskCreate(mesh_dlog_task, "MDLG", 2048, NULL, 1, &s_task) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
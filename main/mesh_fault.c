@@ -0,0 +1,277 @@
+/* Mesh Fault Injection and Recovery Metrics
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <string.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_mesh.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "mesh_fault.h"
+#include "mesh_nodes.h"
+#include "mesh_recovery.h"
+#include "sdkconfig.h"
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define FAULT_TICK_MS           (1000)
+
+/*******************************************************
+ *                Structures
+ *******************************************************/
+typedef struct {
+    const char *cause;
+    uint32_t lost_at_start;
+    uint32_t heap_at_start;
+} fault_event_t;
+
+/*******************************************************
+ *                Variable Definitions
+ *******************************************************/
+static const char *FAULT_TAG = "mesh_fault";
+static SemaphoreHandle_t s_lock = NULL;
+static fault_event_t s_event;
+static mesh_recovery_t s_recovery;
+static mesh_fault_stats_t s_stats;
+static volatile uint32_t s_rx_count = 0;
+static volatile int64_t s_drop_until_us = 0;
+static volatile int64_t s_uplink_down_until_us = 0;
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+static uint32_t fault_total_lost(void)
+{
+#if CONFIG_MESH_ROOT_CAPABLE
+    mesh_seq_stats_t seq;
+    mesh_nodes_get_total_seq_stats(&seq);
+    return seq.lost + seq.late;
+#else
+    /* only a root counts lost readings */
+    return 0;
+#endif
+}
+
+void mesh_fault_note_rx(void)
+{
+    s_rx_count++;
+}
+
+/* Gaps handed over by the previous root happened before this event. */
+void mesh_fault_note_imported(uint32_t lost)
+{
+    if (!s_lock) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (s_recovery.open) {
+        s_event.lost_at_start += lost;
+    }
+    xSemaphoreGive(s_lock);
+}
+
+bool mesh_fault_drop_rx(void)
+{
+    return s_drop_until_us && esp_timer_get_time() < s_drop_until_us;
+}
+
+bool mesh_fault_uplink_down(void)
+{
+    return s_uplink_down_until_us && esp_timer_get_time() < s_uplink_down_until_us;
+}
+
+void mesh_fault_disrupted(const char *cause)
+{
+    if (!s_lock) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    /* nested disruptions (vote during a parent loss) belong to the first one */
+    if (mesh_recovery_start(&s_recovery, esp_timer_get_time())) {
+        s_event.cause = cause;
+        s_event.lost_at_start = fault_total_lost();
+        s_event.heap_at_start = esp_get_free_heap_size();
+        s_stats.events++;
+    }
+    xSemaphoreGive(s_lock);
+}
+
+static void fault_connected_locked(int64_t now_us)
+{
+    uint32_t ms;
+
+    if (mesh_recovery_connected(&s_recovery, now_us, &ms)) {
+        s_stats.connect_ms_sum += ms;
+        if (ms > s_stats.connect_ms_max) {
+            s_stats.connect_ms_max = ms;
+        }
+    }
+}
+
+void mesh_fault_connected(void)
+{
+    if (!s_lock) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    fault_connected_locked(esp_timer_get_time());
+    xSemaphoreGive(s_lock);
+}
+
+/* Called every tick with the lock held, closes the event once settled. */
+static void fault_track_event(int64_t now_us)
+{
+    int result = mesh_recovery_track(&s_recovery, now_us);
+
+    if (result & MESH_RECOVERY_THROUGHPUT) {
+        uint32_t ms = s_recovery.throughput_ms;
+        s_stats.throughput_ms_sum += ms;
+        s_stats.throughput_samples++;
+        if (ms > s_stats.throughput_ms_max) {
+            s_stats.throughput_ms_max = ms;
+        }
+    }
+    if (!(result & MESH_RECOVERY_SETTLED)) {
+        return;
+    }
+    uint32_t lost = fault_total_lost() - s_event.lost_at_start;
+    s_stats.lost += lost;
+    if (!strncmp(s_event.cause, "root_", 5)) {
+        s_stats.root_switches++;
+        s_stats.root_switch_lost += lost;
+    }
+    ESP_LOGW(FAULT_TAG, "[FAULT %s] connect:%dms throughput:%dms baseline:%u/%ds lost:%u heap:%d",
+             s_event.cause,
+             s_recovery.connected ? (int)((s_recovery.connected_us - s_recovery.start_us) / 1000) : -1,
+             s_recovery.throughput_back ? (int)s_recovery.throughput_ms : -1,
+             s_recovery.baseline, MESH_RECOVERY_RATE_SECONDS, lost,
+             (int)esp_get_free_heap_size() - (int)s_event.heap_at_start);
+}
+
+#if CONFIG_MESH_FAULT_INJECTION
+static void fault_inject(mesh_fault_t fault)
+{
+    int64_t until = esp_timer_get_time() + CONFIG_MESH_FAULT_DURATION_MS * 1000LL;
+
+    s_stats.injected++;
+    switch (fault) {
+    case MESH_FAULT_ROOT_FAILOVER:
+        ESP_LOGW(FAULT_TAG, "inject: root failover");
+        mesh_fault_disrupted("root_failover");
+        esp_mesh_waive_root(NULL, MESH_VOTE_REASON_ROOT_INITIATED);
+        break;
+    case MESH_FAULT_PARENT_CHURN:
+        ESP_LOGW(FAULT_TAG, "inject: parent churn");
+        mesh_fault_disrupted("parent_churn");
+        /* the mesh stack reconnects on its own, possibly to another parent */
+        esp_wifi_disconnect();
+        break;
+    case MESH_FAULT_BURST_LOSS:
+        ESP_LOGW(FAULT_TAG, "inject: burst loss for %dms", CONFIG_MESH_FAULT_DURATION_MS);
+        mesh_fault_disrupted("burst_loss");
+        s_drop_until_us = until;
+        break;
+    case MESH_FAULT_UPLINK_OUTAGE:
+        ESP_LOGW(FAULT_TAG, "inject: uplink outage for %dms", CONFIG_MESH_FAULT_DURATION_MS);
+        mesh_fault_disrupted("uplink_outage");
+        s_uplink_down_until_us = until;
+        break;
+    default:
+        break;
+    }
+}
+
+/* Faults only make sense for some roles, the root cycles through its
+ * own and other nodes churn their parent link. */
+static mesh_fault_t fault_next(int *cycle)
+{
+    static const mesh_fault_t root_faults[] = {
+        MESH_FAULT_ROOT_FAILOVER, MESH_FAULT_BURST_LOSS, MESH_FAULT_UPLINK_OUTAGE,
+    };
+    if (!esp_mesh_is_root()) {
+        return MESH_FAULT_PARENT_CHURN;
+    }
+    return root_faults[(*cycle)++ % (sizeof(root_faults) / sizeof(root_faults[0]))];
+}
+#endif
+
+static void mesh_fault_task(void *arg)
+{
+#if CONFIG_MESH_FAULT_INJECTION
+    int cycle = 0;
+    int64_t next_fault_us = esp_timer_get_time() + CONFIG_MESH_FAULT_INTERVAL_S * 1000000LL;
+#endif
+
+    while (true) {
+        vTaskDelay(FAULT_TICK_MS / portTICK_PERIOD_MS);
+        int64_t now_us = esp_timer_get_time();
+        uint32_t rx = s_rx_count;
+
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        mesh_recovery_sample(&s_recovery, rx);
+        /* injected loss and outages are over when their window ends */
+        if (s_drop_until_us && now_us >= s_drop_until_us) {
+            s_drop_until_us = 0;
+            fault_connected_locked(now_us);
+        }
+        if (s_uplink_down_until_us && now_us >= s_uplink_down_until_us) {
+            s_uplink_down_until_us = 0;
+            fault_connected_locked(now_us);
+        }
+        fault_track_event(now_us);
+        s_stats.heap_now = esp_get_free_heap_size();
+        s_stats.heap_min = esp_get_minimum_free_heap_size();
+        xSemaphoreGive(s_lock);
+
+#if CONFIG_MESH_FAULT_INJECTION
+        if (now_us >= next_fault_us) {
+            /* jitter keeps the nodes from churning in lockstep */
+            next_fault_us = now_us + CONFIG_MESH_FAULT_INTERVAL_S * 1000000LL
+                            + (esp_random() % (CONFIG_MESH_FAULT_INTERVAL_S * 1000 / 4 + 1)) * 1000LL;
+            if (esp_mesh_get_layer() > 0 && !s_recovery.open) {
+                fault_inject(fault_next(&cycle));
+            }
+        }
+#endif
+    }
+}
+
+void mesh_fault_get_stats(mesh_fault_stats_t *stats)
+{
+    if (!s_lock) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *stats = s_stats;
+    xSemaphoreGive(s_lock);
+}
+
+esp_err_t mesh_fault_start(void)
+{
+    if (s_lock) {
+        return ESP_OK;
+    }
+    s_lock = xSemaphoreCreateMutex();
+    if (!s_lock) {
+        return ESP_ERR_NO_MEM;
+    }
+    s_stats.heap_start = esp_get_free_heap_size();
+    if (xTaskCreate(mesh_fault_task, "MFLT", 2560, NULL, 3, NULL) != pdPASS) {
+        vSemaphoreDelete(s_lock);
+        s_lock = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,155 @@
+/* Mesh Sensor Sample Filter
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <string.h>
+#include "mesh_filter.h"
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+static bool filter_in_range(const mesh_filter_limits_t *limits, int value)
+{
+    return value >= limits->min && value <= limits->max;
+}
+
+static void filter_push(mesh_filter_channel_t *ch, int window, int value)
+{
+    ch->samples[ch->next] = value;
+    ch->next = (ch->next + 1) % window;
+    if (ch->count < window) {
+        ch->count++;
+    }
+}
+
+/* Insertion sort on a copy, the window is at most MESH_FILTER_WINDOW_MAX. */
+static int filter_median(const mesh_filter_channel_t *ch)
+{
+    int16_t sorted[MESH_FILTER_WINDOW_MAX];
+
+    for (int i = 0; i < ch->count; i++) {
+        int16_t v = ch->samples[i];
+        int j = i;
+        for (; j > 0 && sorted[j - 1] > v; j--) {
+            sorted[j] = sorted[j - 1];
+        }
+        sorted[j] = v;
+    }
+    /* lower median for an even count while warming up */
+    return sorted[(ch->count - 1) / 2];
+}
+
+/* Returns true when the median is within max_step of the last reading, or a
+ * jump has held for step_confirm samples. The run is only cleared once the
+ * whole sample passes, so jumps on both channels confirm together. */
+static bool filter_step_ok(mesh_filter_channel_t *ch, const mesh_filter_limits_t *limits,
+                           int confirm, int median, bool *confirmed)
+{
+    int diff = ch->has_last ? median - ch->last : 0;
+
+    if (diff < 0) {
+        diff = -diff;
+    }
+    if (diff <= limits->max_step) {
+        ch->step_run = 0;
+        return true;
+    }
+    if (ch->step_run < UINT8_MAX) {
+        ch->step_run++;
+    }
+    if (ch->step_run < confirm) {
+        return false;
+    }
+    *confirmed = true;
+    return true;
+}
+
+static int filter_drop(mesh_filter_t *filter, int result)
+{
+    if (filter->dropped < UINT8_MAX) {
+        filter->dropped++;
+    }
+    return result;
+}
+
+void mesh_filter_init(mesh_filter_t *filter, const mesh_filter_config_t *config)
+{
+    memset(filter, 0, sizeof(*filter));
+    filter->config = *config;
+    if (filter->config.window < 1) {
+        filter->config.window = 1;
+    } else if (filter->config.window > MESH_FILTER_WINDOW_MAX) {
+        filter->config.window = MESH_FILTER_WINDOW_MAX;
+    }
+    if (filter->config.step_confirm < 1) {
+        filter->config.step_confirm = 1;
+    }
+}
+
+/* Feed one raw sample. On MESH_FILTER_OK the outputs hold the reading to send;
+ * otherwise nothing should be sent and the sample counts into the next
+ * reading's dropped. */
+int mesh_filter_sample(mesh_filter_t *filter, bool read_ok, int temperature, int humidity,
+                       int *temperature_out, int *humidity_out, uint8_t *quality, uint8_t *dropped)
+{
+    const mesh_filter_config_t *cfg = &filter->config;
+    bool t_confirmed = false;
+    bool h_confirmed = false;
+
+    filter->stats.samples++;
+    if (!read_ok) {
+        filter->stats.read_errors++;
+        return filter_drop(filter, MESH_FILTER_READ_ERROR);
+    }
+    /* a checksum can pass on a corrupted frame, values the sensor cannot
+     * report never reach the window */
+    if (!filter_in_range(&cfg->temperature, temperature) || !filter_in_range(&cfg->humidity, humidity)) {
+        filter->stats.range++;
+        return filter_drop(filter, MESH_FILTER_RANGE);
+    }
+
+    filter_push(&filter->temperature, cfg->window, temperature);
+    filter_push(&filter->humidity, cfg->window, humidity);
+    int t = filter_median(&filter->temperature);
+    int h = filter_median(&filter->humidity);
+
+    bool t_ok = filter_step_ok(&filter->temperature, &cfg->temperature, cfg->step_confirm, t, &t_confirmed);
+    bool h_ok = filter_step_ok(&filter->humidity, &cfg->humidity, cfg->step_confirm, h, &h_confirmed);
+    if (!t_ok || !h_ok) {
+        filter->stats.step++;
+        return filter_drop(filter, MESH_FILTER_STEP);
+    }
+
+    *quality = 0;
+    if (filter->temperature.count < cfg->window) {
+        *quality |= MESH_QUALITY_WARMUP;
+    }
+    if (t != temperature || h != humidity) {
+        *quality |= MESH_QUALITY_SMOOTHED;
+        filter->stats.smoothed++;
+    }
+    if (t_confirmed || h_confirmed) {
+        *quality |= MESH_QUALITY_STEP;
+    }
+    if (filter->dropped) {
+        *quality |= MESH_QUALITY_GAP;
+    }
+    *dropped = filter->dropped;
+    filter->dropped = 0;
+
+    filter->temperature.step_run = 0;
+    filter->temperature.last = t;
+    filter->temperature.has_last = true;
+    filter->humidity.step_run = 0;
+    filter->humidity.last = h;
+    filter->humidity.has_last = true;
+    *temperature_out = t;
+    *humidity_out = h;
+    filter->stats.passed++;
+    return MESH_FILTER_OK;
+}
@@ -0,0 +1,223 @@
+/* Mesh Root Handoff
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <string.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_mesh.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "tcpip_adapter.h"
+#include "mesh_fault.h"
+#include "mesh_handoff.h"
+#include "mesh_nodes.h"
+#include "mesh_stream.h"
+#include "sdkconfig.h"
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define HANDOFF_FRAME_SIZE          (1456) /* below MESH_MPS */
+#define HANDOFF_PAYLOAD_SIZE        (HANDOFF_FRAME_SIZE - sizeof(mesh_handoff_hdr_t))
+#define HANDOFF_NODES_PER_FRAME     (HANDOFF_PAYLOAD_SIZE / sizeof(mesh_node_state_t))
+#define HANDOFF_RECORDS_PER_FRAME   (HANDOFF_PAYLOAD_SIZE / sizeof(mesh_stream_record_t))
+#define HANDOFF_DRAIN_MS            (3000) /* readings still arrive until the switch is done */
+#define HANDOFF_DRAIN_POLL_MS       (100)
+
+/*******************************************************
+ *                Variable Definitions
+ *******************************************************/
+static const char *HANDOFF_TAG = "mesh_handoff";
+static uint8_t s_frame[HANDOFF_FRAME_SIZE];
+static mesh_addr_t s_new_root;
+static volatile bool s_busy = false;
+static uint32_t s_in_id = 0;
+static uint32_t s_in_records = 0;
+static mesh_handoff_stats_t s_stats;
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+static esp_err_t handoff_send(uint8_t type, uint32_t id, int count, size_t body_len)
+{
+    mesh_handoff_hdr_t hdr = {
+        .type = type,
+        .count = count,
+        .id = id,
+    };
+    mesh_data_t data = {
+        .data = s_frame,
+        .size = sizeof(hdr) + body_len,
+        .proto = MESH_PROTO_BIN,
+        .tos = MESH_TOS_P2P,
+    };
+
+    memcpy(s_frame, &hdr, sizeof(hdr));
+    esp_err_t err = esp_mesh_send(&s_new_root, &data, MESH_DATA_P2P, NULL, 0);
+    if (err != ESP_OK) {
+        s_stats.send_errors++;
+        ESP_LOGE(HANDOFF_TAG, "send type:0x%02x to "MACSTR" failed: 0x%x",
+                 type, MAC2STR(s_new_root.addr), err);
+    }
+    return err;
+}
+
+/* Hand over whatever is queued right now, returns records sent or -1. */
+static int handoff_records(uint32_t id)
+{
+    mesh_stream_record_t *records = (mesh_stream_record_t *)(s_frame + sizeof(mesh_handoff_hdr_t));
+    int total = 0;
+    int n;
+
+    while ((n = mesh_stream_take_pending(records, HANDOFF_RECORDS_PER_FRAME)) > 0) {
+        if (handoff_send(MESH_FRAME_HANDOFF_RECORDS, id, n, n * sizeof(*records)) != ESP_OK) {
+            /* keep them, they go out on our own uplink or with the next handoff */
+            for (int i = 0; i < n; i++) {
+                mesh_stream_push(records[i].addr, records[i].node_session, records[i].node_seq,
+                                 records[i].node_id, records[i].layer, records[i].temperature,
+                                 records[i].humidity);
+            }
+            return -1;
+        }
+        total += n;
+    }
+    return total;
+}
+
+static void mesh_handoff_task(void *arg)
+{
+    mesh_node_state_t *states = (mesh_node_state_t *)(s_frame + sizeof(mesh_handoff_hdr_t));
+    uint32_t id = esp_random();
+    int64_t start_us = esp_timer_get_time();
+    mesh_handoff_done_t done = { 0, };
+    int n;
+
+    s_stats.handoffs_out++;
+    ESP_LOGW(HANDOFF_TAG, "handing off to "MACSTR"", MAC2STR(s_new_root.addr));
+
+    while ((n = mesh_nodes_export(done.nodes, states, HANDOFF_NODES_PER_FRAME)) > 0) {
+        if (handoff_send(MESH_FRAME_HANDOFF_NODES, id, n, n * sizeof(*states)) != ESP_OK) {
+            break;
+        }
+        done.nodes += n;
+    }
+
+    /* keep forwarding what comes in until the new root has taken over */
+    while (true) {
+        n = handoff_records(id);
+        if (n < 0) {
+            break;
+        }
+        done.records += n;
+        if (!esp_mesh_is_root() || esp_timer_get_time() - start_us >= HANDOFF_DRAIN_MS * 1000LL) {
+            break;
+        }
+        vTaskDelay(HANDOFF_DRAIN_POLL_MS / portTICK_PERIOD_MS);
+    }
+
+    memcpy(s_frame + sizeof(mesh_handoff_hdr_t), &done, sizeof(done));
+    handoff_send(MESH_FRAME_HANDOFF_DONE, id, 0, sizeof(done));
+    s_stats.nodes_sent += done.nodes;
+    s_stats.records_sent += done.records;
+    ESP_LOGW(HANDOFF_TAG, "handoff done, nodes:%u records:%u in %dms", done.nodes, done.records,
+             (int)((esp_timer_get_time() - start_us) / 1000));
+    s_busy = false;
+    vTaskDelete(NULL);
+}
+
+esp_err_t mesh_handoff_start(const mesh_addr_t *new_root)
+{
+    if (s_busy) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_busy = true;
+    s_new_root = *new_root;
+    if (xTaskCreate(mesh_handoff_task, "MHOF", 3072, NULL, 5, NULL) != pdPASS) {
+        s_busy = false;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+/* Frames come in on the rx task, before or after this node became root. */
+void mesh_handoff_recv(const mesh_addr_t *from, const uint8_t *frame, int size)
+{
+    mesh_handoff_hdr_t hdr;
+    const uint8_t *body = frame + sizeof(hdr);
+
+    if (size < sizeof(hdr)) {
+        return;
+    }
+    memcpy(&hdr, frame, sizeof(hdr));
+    size -= sizeof(hdr);
+    if (hdr.id != s_in_id) {
+        s_in_id = hdr.id;
+        s_in_records = 0;
+        s_stats.handoffs_in++;
+        ESP_LOGW(HANDOFF_TAG, "taking over from "MACSTR"", MAC2STR(from->addr));
+    }
+
+    switch (hdr.type) {
+    case MESH_FRAME_HANDOFF_NODES: {
+        mesh_node_state_t state;
+        uint32_t lost = 0;
+        for (int i = 0; i < hdr.count && (i + 1) * sizeof(state) <= size; i++) {
+            memcpy(&state, body + i * sizeof(state), sizeof(state));
+            if (mesh_nodes_import(&state) == ESP_OK) {
+                lost += state.lost;
+                s_stats.nodes_received++;
+            }
+        }
+        mesh_fault_note_imported(lost);
+    }
+    break;
+    case MESH_FRAME_HANDOFF_RECORDS: {
+        mesh_stream_record_t rec;
+        for (int i = 0; i < hdr.count && (i + 1) * sizeof(rec) <= size; i++) {
+            memcpy(&rec, body + i * sizeof(rec), sizeof(rec));
+            /* stream sequence is reassigned, node_session and node_seq let the collector dedup */
+            mesh_stream_push(rec.addr, rec.node_session, rec.node_seq, rec.node_id, rec.layer,
+                             rec.temperature, rec.humidity);
+            s_in_records++;
+            s_stats.records_received++;
+        }
+    }
+    break;
+    case MESH_FRAME_HANDOFF_DONE: {
+        mesh_handoff_done_t done;
+        if (size < sizeof(done)) {
+            break;
+        }
+        memcpy(&done, body, sizeof(done));
+        if (done.records > s_in_records) {
+            s_stats.records_missed += done.records - s_in_records;
+        }
+        ESP_LOGW(HANDOFF_TAG, "handoff from "MACSTR" complete, nodes:%u records:%u/%u",
+                 MAC2STR(from->addr), done.nodes, s_in_records, done.records);
+    }
+    break;
+    default:
+        ESP_LOGW(HANDOFF_TAG, "unknown frame type:0x%02x from "MACSTR"", hdr.type, MAC2STR(from->addr));
+        break;
+    }
+}
+
+/* Bring the uplink up now instead of on the first reading. */
+void mesh_handoff_became_root(void)
+{
+    tcpip_adapter_dhcpc_start(TCPIP_ADAPTER_IF_STA);
+    mesh_stream_kick();
+}
+
+void mesh_handoff_get_stats(mesh_handoff_stats_t *stats)
+{
+    *stats = s_stats;
+}
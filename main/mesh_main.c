@@ -7,16 +7,29 @@
 #include "esp_log.h"
 #include "esp_mesh.h"
 #include "esp_mesh_internal.h"
+#include "mesh_api.h"
+#include "mesh_budget.h"
+#include "mesh_capture.h"
+#include "mesh_dlog.h"
+#include "mesh_fault.h"
+#include "mesh_filter.h"
+#include "mesh_handoff.h"
 #include "mesh_light.h"
+#include "mesh_nodes.h"
+#include "mesh_rate.h"
+#include "mesh_stream.h"
+#include "mesh_tasks.h"
+#include "mesh_topo.h"
+#include "mesh_tx.h"
+#include "mesh_uplink.h"
 #include "nvs_flash.h"
-#include "esp_http_client.h"
+#include "esp_timer.h"
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "driver/gpio.h"
 #include "sdkconfig.h"
 
-#define MAX_HTTP_RECV_BUFFER 512
 static const char *TAG = "HTTP_CLIENT";
 
 /*******************************************************
@@ -27,20 +40,53 @@ static const char *TAG = "HTTP_CLIENT";
  *                Constants
  *******************************************************/
 #define RX_SIZE          (1500)
-#define TX_SIZE          (1460)
+#define SUMMARY_BATCH    (8)
+#define SUMMARY_SIZE     (SUMMARY_BATCH * 360)
 #define CONFIG_NODE_ID 1
 
+/* reading layout inside the mesh frame, byte MESH_FRAME_TYPE is MESH_FRAME_READING */
+#define FRAME_PARENT        (1)  /* softAP BSSID of the sender's parent */
+#define FRAME_SELF_AP       (7)  /* sender's own softAP BSSID */
+#define FRAME_QUALITY       (13) /* MESH_QUALITY_* flags */
+#define FRAME_DROPPED       (14) /* samples the filter dropped before this one */
+#define FRAME_NODE_ID       (22)
+#define FRAME_TEMPERATURE   (23)
+#define FRAME_HUMIDITY      (24)
+#define FRAME_LAYER         (25)
+#define FRAME_SEQ           (26) /* u32, little endian */
+#define FRAME_SESSION       (30) /* u16, little endian, random per boot */
+#define FRAME_SIZE          (32)
+
 /*******************************************************
  *                Variable Definitions
  *******************************************************/
 static const char *MESH_TAG = "mesh_main";
 static const uint8_t MESH_ID[6] = { 0x77, 0x77, 0x77, 0x77, 0x77, 0x77};
-static uint8_t tx_buf[TX_SIZE] = { 0, };
 static uint8_t rx_buf[RX_SIZE] = { 0, };
 static bool is_running = true;
 static bool is_mesh_connected = false;
 static mesh_addr_t mesh_parent_addr;
 static int mesh_layer = -1;
+#if CONFIG_MESH_SENSOR
+static uint8_t tx_buf[MESH_TX_FRAME_MAX] = { 0, };
+static uint32_t tx_seq = 0;
+static uint16_t tx_session = 0;
+static mesh_filter_t s_filter;
+/* DHT11 reports 0-50 C and 20-90 %RH, anything well outside is a corrupted frame */
+static const mesh_filter_config_t s_filter_config = {
+    .window = CONFIG_MESH_FILTER_WINDOW,
+    .step_confirm = CONFIG_MESH_FILTER_STEP_CONFIRM,
+    .temperature = { .min = 0, .max = 60, .max_step = CONFIG_MESH_FILTER_TEMPERATURE_STEP },
+    .humidity = { .min = 5, .max = 95, .max_step = CONFIG_MESH_FILTER_HUMIDITY_STEP },
+};
+static mesh_rate_t s_rate;
+static const mesh_rate_config_t s_rate_config = {
+    .min_interval_ms = CONFIG_MESH_RATE_MIN_INTERVAL_MS,
+    .max_interval_ms = CONFIG_MESH_RATE_MAX_INTERVAL_MS,
+    .calm_x100 = CONFIG_MESH_RATE_CALM_X100,
+    .busy_x100 = CONFIG_MESH_RATE_BUSY_X100,
+};
+#endif
 
 mesh_light_ctl_t light_on = {
     .cmd = MESH_CONTROL_CMD,
@@ -56,6 +102,7 @@ mesh_light_ctl_t light_off = {
     .token_value = MESH_TOKEN_VALUE,
 };
 
+#if CONFIG_MESH_SENSOR
 enum dht11_status {
     DHT11_CRC_ERROR = -2,
     DHT11_TIMEOUT_ERROR,
@@ -67,6 +114,7 @@ struct dht11_reading {
     int temperature;
     int humidity;
 };
+#endif
 
 /*******************************************************
  *                Function Declarations
@@ -75,7 +123,7 @@ struct dht11_reading {
 /*******************************************************
  *                Function Definitions
  *******************************************************/
-
+#if CONFIG_MESH_SENSOR
  static gpio_num_t dht_gpio;
  static int64_t last_read_time = -2000000;
  static struct dht11_reading last_read;
@@ -134,6 +182,11 @@ struct dht11_reading {
      dht_gpio = gpio_num;
  }
 
+ /* false while DHT11_read would only return the previous reading */
+ static bool DHT11_due(void) {
+     return esp_timer_get_time() - 2000000 >= last_read_time;
+ }
+
  struct dht11_reading DHT11_read() {
      /* Tried to sense too son since last read (dht11 needs ~2 seconds to make a new read) */
      if(esp_timer_get_time() - 2000000 < last_read_time) {
@@ -170,136 +223,174 @@ struct dht11_reading {
          return last_read = _crcError();
      }
  }
+#endif
 
- esp_err_t _http_event_handler(esp_http_client_event_t *evt)
- {
-     switch(evt->event_id) {
-         case HTTP_EVENT_ERROR:
-             ESP_LOGD(TAG, "HTTP_EVENT_ERROR");
-             break;
-         case HTTP_EVENT_ON_CONNECTED:
-             ESP_LOGD(TAG, "HTTP_EVENT_ON_CONNECTED");
-             break;
-         case HTTP_EVENT_HEADER_SENT:
-             ESP_LOGD(TAG, "HTTP_EVENT_HEADER_SENT");
-             break;
-         case HTTP_EVENT_ON_HEADER:
-             ESP_LOGD(TAG, "HTTP_EVENT_ON_HEADER, key=%s, value=%s", evt->header_key, evt->header_value);
-             break;
-         case HTTP_EVENT_ON_DATA:
-             ESP_LOGD(TAG, "HTTP_EVENT_ON_DATA, len=%d", evt->data_len);
-             if (!esp_http_client_is_chunked_response(evt->client)) {
-                 // Write out data
-                 // printf("%.*s", evt->data_len, (char*)evt->data);
-             }
-
-             break;
-         case HTTP_EVENT_ON_FINISH:
-             ESP_LOGD(TAG, "HTTP_EVENT_ON_FINISH");
-             break;
-         case HTTP_EVENT_DISCONNECTED:
-             ESP_LOGD(TAG, "HTTP_EVENT_DISCONNECTED");
-             break;
-     }
-     return ESP_OK;
- }
-
+#if CONFIG_MESH_ROOT_CAPABLE
 void node_data(char *data) {
-    esp_http_client_config_t config = {
-         .url = "http://192.168.43.49:3000",
-         .event_handler = _http_event_handler,
-    };
-     esp_http_client_handle_t client = esp_http_client_init(&config);
-     esp_err_t err = esp_http_client_perform(client);
-
-     char post_data[300] = "data=";
-     strcat(post_data, data);
-
-     esp_http_client_set_url(client, "http://192.168.43.49:3000");
-     esp_http_client_set_method(client, HTTP_METHOD_POST);
-     esp_http_client_set_post_field(client, post_data, strlen(post_data));
-     err = esp_http_client_perform(client);
-     if (err == ESP_OK) {
-          ESP_LOGI(TAG, "HTTP POST Status = %d, content_length = %d",
-                      esp_http_client_get_status_code(client),
-                      esp_http_client_get_content_length(client));
-     } else {
-          ESP_LOGE(TAG, "HTTP POST request failed: %s", esp_err_to_name(err));
-     }
+    if (mesh_fault_uplink_down()) {
+        ESP_LOGW(TAG, "uplink down, reading not posted");
+        return;
+    }
+    /* the breaker counts failures and fast fails, see /stats */
+    mesh_uplink_post(data);
+}
+#endif
 
-     esp_http_client_cleanup(client);
+#if CONFIG_MESH_SUMMARY_INTERVAL
+static int summary_metric_json(char *buf, size_t size, const char *name,
+                               const mesh_metric_summary_t *m)
+{
+    return snprintf(buf, size, "\"%s\":{\"last\":%d, \"ewma_x100\":%d, "
+                    "\"min_5m\":%d, \"max_5m\":%d, \"mean_5m_x100\":%d, \"count_5m\":%u, "
+                    "\"min_1h\":%d, \"max_1h\":%d, \"mean_1h_x100\":%d, \"count_1h\":%u}",
+                    name, m->last, m->ewma_x100,
+                    m->short_win.min, m->short_win.max, m->short_win.mean_x100, m->short_win.count,
+                    m->long_win.min, m->long_win.max, m->long_win.mean_x100, m->long_win.count);
 }
 
+/* Post the root's per-node aggregates in place of the raw readings. */
+static void node_summaries(void)
+{
+    static mesh_node_summary_t summaries[SUMMARY_BATCH];
+    static char json[SUMMARY_SIZE];
+    int start = 0;
+    int n;
+
+    while ((n = mesh_nodes_get_summaries(start, summaries, SUMMARY_BATCH)) > 0) {
+        int len = snprintf(json, sizeof(json), "{\"summary\":[");
+        for (int i = 0; i < n && len < sizeof(json); i++) {
+            const mesh_node_summary_t *node = &summaries[i];
+            len += snprintf(json + len, sizeof(json) - len,
+                            "%s{\"id\":%d, \"address\":\""MACSTR"\", \"layer\":%d, \"age\":%u, ",
+                            i ? ", " : "", node->node_id, MAC2STR(node->addr), node->layer, node->age_s);
+            len += summary_metric_json(json + len, sizeof(json) - len, "temperature", &node->temperature);
+            len += snprintf(json + len, sizeof(json) - len, ", ");
+            len += summary_metric_json(json + len, sizeof(json) - len, "humidity", &node->humidity);
+            len += snprintf(json + len, sizeof(json) - len, "}");
+        }
+        len += snprintf(json + len, sizeof(json) - len, "]}");
+        if (len >= sizeof(json)) {
+            ESP_LOGE(TAG, "summary truncated, %d bytes", len);
+        } else {
+            node_data(json);
+        }
+        start += n;
+    }
+}
+#endif
+
+#if CONFIG_MESH_SENSOR
+static void tx_send_reading(int send_count, int temperature, int humidity, uint8_t quality, uint8_t dropped)
+{
+    mesh_tx_stats_t tx_stats;
+
+    tx_seq++;
+    tx_buf[MESH_FRAME_TYPE] = MESH_FRAME_READING;
+    memcpy(&tx_buf[FRAME_PARENT], mesh_parent_addr.addr, 6);
+    tx_buf[FRAME_QUALITY] = quality;
+    tx_buf[FRAME_DROPPED] = dropped;
+    tx_buf[FRAME_NODE_ID] = CONFIG_NODE_ID;
+    tx_buf[FRAME_TEMPERATURE] = temperature;
+    tx_buf[FRAME_HUMIDITY] = humidity;
+    tx_buf[FRAME_LAYER] = mesh_layer;
+    memcpy(&tx_buf[FRAME_SEQ], &tx_seq, sizeof(tx_seq));
+    memcpy(&tx_buf[FRAME_SESSION], &tx_session, sizeof(tx_session));
+
+    /* never blocks, a congested parent only fills the retry queue */
+    esp_err_t err = mesh_tx_send(tx_buf, FRAME_SIZE);
+    if (err) {
+        MESH_DLOGW(MESH_TAG,
+                   "[ROOT-2-UNICAST:%d][L:%d]parent:"MACSTR", heap:%d deferred[err:0x%x]",
+                   send_count, mesh_layer, MAC2STR(mesh_parent_addr.addr),
+                   esp_get_free_heap_size(), err);
+    } else if (!(send_count % 10)) {
+        mesh_tx_get_stats(&tx_stats);
+        MESH_DLOGW(MESH_TAG,
+                   "[ROOT-2-UNICAST:%d (count %d)][L:%d][rtableSize:%d]parent:"MACSTR", heap:%d[sent:%u deferred:%u retried:%u dropped:%u queued:%u]",
+                   temperature, send_count, mesh_layer,
+                   esp_mesh_get_routing_table_size(),
+                   MAC2STR(mesh_parent_addr.addr),
+                   esp_get_free_heap_size(),
+                   tx_stats.sent, tx_stats.deferred, tx_stats.retried,
+                   tx_stats.dropped, tx_stats.queued);
+        MESH_DLOGW(MESH_TAG, "[FILTER]samples:%u passed:%u read_errors:%u range:%u step:%u smoothed:%u",
+                   s_filter.stats.samples, s_filter.stats.passed, s_filter.stats.read_errors,
+                   s_filter.stats.range, s_filter.stats.step, s_filter.stats.smoothed);
+        MESH_DLOGW(MESH_TAG, "[RATE]interval:%ums volatility_x100:%u floor:%ums",
+                   s_rate.interval_ms, s_rate.volatility_x100, mesh_budget_floor_ms());
+    }
+}
 
  void esp_mesh_p2p_tx_projeto(void *arg)
  {
-     esp_err_t err;
      int send_count = 0;
 
      int temperature = 0;
      int humidity = 0;
+     uint8_t quality = 0;
+     uint8_t dropped = 0;
+     int64_t next_sample_us = 0;
+     int64_t last_sent_us = 0;
 
      mesh_addr_t route_table[CONFIG_MESH_ROUTE_TABLE_SIZE];
      int route_table_size = 0;
-     mesh_data_t data;
-     data.data = tx_buf;
-     data.size = sizeof(tx_buf);
-     data.proto = MESH_PROTO_BIN;
-     data.tos = MESH_TOS_P2P;
      is_running = true;
+     mesh_filter_init(&s_filter, &s_filter_config);
+     mesh_rate_init(&s_rate, &s_rate_config);
+     /* lets the root place this node under its parent, see mesh_topo */
+     esp_read_mac(&tx_buf[FRAME_SELF_AP], ESP_MAC_WIFI_SOFTAP);
+     /* tx_seq starts over with it, WiFi is up so esp_random() is a true RNG here */
+     tx_session = esp_random();
 
      while (is_running) {
+         int64_t busy_start = esp_timer_get_time();
          esp_mesh_get_routing_table((mesh_addr_t *) &route_table,
                                     CONFIG_MESH_ROUTE_TABLE_SIZE * 6, &route_table_size);
          if (send_count && !(send_count % 10)) {
-             ESP_LOGI(MESH_TAG, "size:%d/%d,send_value:%d ,send_count:%d", route_table_size,
+             MESH_DLOGI(MESH_TAG, "size:%d/%d,send_value:%d ,send_count:%d", route_table_size,
                       esp_mesh_get_routing_table_size(), temperature, send_count);
          }
-         send_count++;
-
-         if(DHT11_read().status == 0) {
-             ESP_LOGI(MESH_TAG, "Temperature is %d, Humidity is %d, Status %d",
-             DHT11_read().temperature, DHT11_read().humidity, DHT11_read().status);
-             temperature = DHT11_read().temperature;
-             humidity = DHT11_read().humidity;
-         } else {
-             ESP_LOGI(MESH_TAG, "HDT11 ERROR Status %d", DHT11_read().status);
+         /* the rate controller decides when the next reading is due, a dropped
+          * sample is retried as soon as the sensor has a new one */
+         if (esp_timer_get_time() >= next_sample_us && DHT11_due()) {
+             struct dht11_reading reading = DHT11_read();
+             int result = mesh_filter_sample(&s_filter, reading.status == DHT11_OK,
+                                             reading.temperature, reading.humidity,
+                                             &temperature, &humidity, &quality, &dropped);
+             /* raw trace for tools/filter_trace.py */
+             MESH_DLOGI(MESH_TAG, "DHT sample status %d raw %d/%d result %d",
+                        reading.status, reading.temperature, reading.humidity, result);
+             if (result == MESH_FILTER_OK) {
+                 MESH_DLOGI(MESH_TAG, "Temperature is %d, Humidity is %d, quality 0x%02x, dropped %d",
+                            temperature, humidity, quality, dropped);
+                 int64_t now_us = esp_timer_get_time();
+                 uint32_t elapsed_ms = last_sent_us ? (now_us - last_sent_us) / 1000 : 0;
+                 uint32_t interval_ms = mesh_rate_update(&s_rate, temperature, humidity, elapsed_ms,
+                                                         mesh_budget_floor_ms());
+                 last_sent_us = now_us;
+                 next_sample_us = now_us + interval_ms * 1000LL;
+                 tx_send_reading(++send_count, temperature, humidity, quality, dropped);
+             }
          }
-
-         tx_buf[22] = CONFIG_NODE_ID;
-         tx_buf[23] = temperature;
-         tx_buf[24] = humidity;
-         tx_buf[25] = mesh_layer;
-
-         err = esp_mesh_send(NULL, &data, 0, NULL, 0);
-
-          if (err) {
-                          ESP_LOGE(MESH_TAG,
-                                   "[ROOT-2-UNICAST:%d][L:%d]parent:"MACSTR", heap:%d[err:0x%x, proto:%d, tos:%d]",
-                                   send_count, mesh_layer, MAC2STR(mesh_parent_addr.addr),
-                                   esp_get_free_heap_size(),
-                                   err, data.proto, data.tos);
-                      } else if (!(send_count % 10)) {
-                          ESP_LOGW(MESH_TAG,
-                                   "[ROOT-2-UNICAST:%d (count %d)][L:%d][rtableSize:%d]parent:"MACSTR", heap:%d[err:0x%x, proto:%d, tos:%d]",
-                                   temperature, send_count, mesh_layer,
-                                   esp_mesh_get_routing_table_size(),
-                                   MAC2STR(mesh_parent_addr.addr),
-                                   esp_get_free_heap_size(),
-                                   err, data.proto, data.tos);
-                      }
+         /* otherwise the sensor has nothing new, resending the last reading would be junk */
 
 //         for (i = 0; i < route_table_size; i++) {
 //
 //
 //         }
-         /* if route_table_size is less than 10, add delay to avoid watchdog in this task. */
+         /* if route_table_size is less than 10, add delay to avoid watchdog in this task.
+          * Sends no longer block, so larger meshes still yield for a tick. Queued
+          * readings are retried while waiting. */
+         mesh_tasks_note_work(MESH_TASK_TX, busy_start);
          if (route_table_size < 10) {
-             vTaskDelay(1 * 1000 / portTICK_RATE_MS);
+             mesh_tx_wait(1 * 1000);
+         } else {
+             mesh_tx_wait(portTICK_RATE_MS);
          }
      }
      vTaskDelete(NULL);
  }
+#endif
 
 
 void esp_mesh_p2p_rx_projeto(void *arg)
@@ -310,42 +401,131 @@ void esp_mesh_p2p_rx_projeto(void *arg)
     int temperature = 0;
     int humidity = 0;
     int mesh_layer_rec = 0;
+    int quality = 0;
+    int dropped = 0;
+    uint32_t seq = 0;
+    uint16_t session = 0;
+#if CONFIG_MESH_ROOT_CAPABLE
+    int recv_count = 0;
+#endif
+    int rx_timeout = portMAX_DELAY;
+    int64_t busy_start = 0;
     mesh_data_t data;
     int flag = 0;
     data.data = rx_buf;
     data.size = RX_SIZE;
     is_running = true;
 //    node_connected(MAC2STR(from.addr));
+#if CONFIG_MESH_SUMMARY_INTERVAL
+    int64_t last_summary = esp_timer_get_time();
+    /* wake up for the summary even when the mesh is quiet */
+    rx_timeout = 1000;
+#endif
 
     while (is_running) {
+        /* every path back here ends the work on the previous frame */
+        if (busy_start) {
+            mesh_tasks_note_work(MESH_TASK_RX, busy_start);
+            busy_start = 0;
+        }
+#if CONFIG_MESH_SUMMARY_INTERVAL
+        if (esp_timer_get_time() - last_summary >= CONFIG_MESH_SUMMARY_INTERVAL * 1000000LL) {
+            last_summary = esp_timer_get_time();
+            if (esp_mesh_is_root()) {
+                node_summaries();
+            }
+        }
+#endif
         data.size = RX_SIZE;
-        err = esp_mesh_recv(&from, &data, portMAX_DELAY, &flag, NULL, 0);
+        err = esp_mesh_recv(&from, &data, rx_timeout, &flag, NULL, 0);
+        if (err == ESP_ERR_MESH_TIMEOUT) {
+            continue;
+        }
+        busy_start = esp_timer_get_time();
         if (err != ESP_OK || !data.size) {
             ESP_LOGE(MESH_TAG, "err:0x%x, size:%d", err, data.size);
             continue;
         }
-
-        node_id = data.data[22];
-        temperature = data.data[23];
-        humidity = data.data[24];
-        mesh_layer_rec = data.data[25];
-
-        ESP_LOGW(MESH_TAG,
-                          "[#RX:id %d Temperature %d Humidity %d][L:%d] parent:"MACSTR", receive from "MACSTR", size:%d, heap:%d, flag:%d[err:0x%x, proto:%d, tos:%d]",
-                             node_id, temperature, humidity, mesh_layer_rec,
+#if CONFIG_MESH_CAPTURE
+        /* before fault injection, the capture keeps what the radio delivered */
+        if (esp_mesh_is_root()) {
+            mesh_capture_frame(&from, data.data, data.size, flag);
+        }
+#endif
+        if (mesh_fault_drop_rx()) {
+            continue;
+        }
+        switch (data.data[MESH_FRAME_TYPE]) {
+        case MESH_FRAME_READING:
+            break;
+        case MESH_FRAME_REPARENT:
+            mesh_topo_recv_reparent(&from, data.data, data.size);
+            continue;
+        case MESH_FRAME_RATE_FLOOR:
+            mesh_budget_recv(&from, data.data, data.size);
+            continue;
+#if CONFIG_MESH_ROOT_CAPABLE
+        case MESH_FRAME_HANDOFF_NODES:
+        case MESH_FRAME_HANDOFF_RECORDS:
+        case MESH_FRAME_HANDOFF_DONE:
+            mesh_handoff_recv(&from, data.data, data.size);
+            continue;
+#endif
+        default:
+            ESP_LOGW(MESH_TAG, "unknown frame type:0x%02x from "MACSTR", size:%d",
+                     data.data[MESH_FRAME_TYPE], MAC2STR(from.addr), data.size);
+            continue;
+        }
+        if (data.size < FRAME_SIZE) {
+            ESP_LOGE(MESH_TAG, "short frame from "MACSTR", size:%d", MAC2STR(from.addr), data.size);
+            continue;
+        }
+        mesh_fault_note_rx();
+
+        node_id = data.data[FRAME_NODE_ID];
+        temperature = data.data[FRAME_TEMPERATURE];
+        humidity = data.data[FRAME_HUMIDITY];
+        mesh_layer_rec = data.data[FRAME_LAYER];
+        quality = data.data[FRAME_QUALITY];
+        dropped = data.data[FRAME_DROPPED];
+        memcpy(&seq, &data.data[FRAME_SEQ], sizeof(seq));
+        memcpy(&session, &data.data[FRAME_SESSION], sizeof(session));
+
+        MESH_DLOGW(MESH_TAG,
+                          "[#RX:id %d seq %04x:%u Temperature %d Humidity %d Q:0x%02x D:%d][L:%d] parent:"MACSTR", receive from "MACSTR", size:%d, heap:%d, flag:%d[err:0x%x, proto:%d, tos:%d]",
+                             node_id, session, seq, temperature, humidity, quality, dropped, mesh_layer_rec,
                              MAC2STR(mesh_parent_addr.addr), MAC2STR(from.addr),
                              data.size, esp_get_free_heap_size(), flag, err, data.proto,
                              data.tos);
 
+#if CONFIG_MESH_ROOT_CAPABLE
         if (esp_mesh_is_root()) {
+            /* retries and re-routing during a root switch can deliver a frame twice */
+            if (mesh_nodes_check_seq(from.addr, session, seq, mesh_layer_rec) == MESH_SEQ_DUPLICATE) {
+                MESH_DLOGW(MESH_TAG, "drop duplicate seq %u from "MACSTR"", seq, MAC2STR(from.addr));
+                continue;
+            }
+            if (!(++recv_count % 100)) {
+                mesh_nodes_log_seq_stats();
+            }
+            mesh_nodes_update(from.addr, node_id, mesh_layer_rec, temperature, humidity);
+            mesh_nodes_note_link(from.addr, &data.data[FRAME_SELF_AP], &data.data[FRAME_PARENT]);
+#if CONFIG_MESH_SUMMARY_INTERVAL
+            /* raw readings are replaced by the periodic summary */
+#elif CONFIG_MESH_UPLINK_STREAM
+            mesh_stream_push(from.addr, session, seq, node_id, mesh_layer_rec, temperature, humidity);
+#else
             char *date;
-            asprintf(&date, "{\"id\":%d, \"temperature\":%d, \"humidity\":%d, \"layer\": %d, \"parent\":\""MACSTR"\", \"address\":\""MACSTR"\", \"size\":%d, \"heap\":%d, \"flag\":%d, \"err\":\"0x%x\", \"proto\":%d, \"tos\":%d}",
-                                                         node_id, temperature, humidity, mesh_layer_rec,
+            asprintf(&date, "{\"id\":%d, \"session\":%u, \"seq\":%u, \"temperature\":%d, \"humidity\":%d, \"quality\":%d, \"dropped\":%d, \"layer\": %d, \"parent\":\""MACSTR"\", \"address\":\""MACSTR"\", \"size\":%d, \"heap\":%d, \"flag\":%d, \"err\":\"0x%x\", \"proto\":%d, \"tos\":%d}",
+                                                         node_id, session, seq, temperature, humidity, quality, dropped, mesh_layer_rec,
                                                          MAC2STR(mesh_parent_addr.addr), MAC2STR(from.addr),
                                                          data.size, esp_get_free_heap_size(), flag, err, data.proto,
                                                          data.tos);
             node_data(date);
+            free(date);
+#endif
         }
+#endif
 
     }
     vTaskDelete(NULL);
@@ -357,8 +537,17 @@ esp_err_t esp_mesh_comm_p2p_start(void)
     static bool is_comm_p2p_started = false;
     if (!is_comm_p2p_started) {
         is_comm_p2p_started = true;
-        xTaskCreate(esp_mesh_p2p_tx_projeto, "MPTX", 3072, NULL, 5, NULL);
-        xTaskCreate(esp_mesh_p2p_rx_projeto, "MPRX", 3072, NULL, 5, NULL);
+        mesh_tasks_update_role();
+#if CONFIG_MESH_SENSOR
+        mesh_tasks_create(MESH_TASK_TX, esp_mesh_p2p_tx_projeto, "MPTX", NULL);
+#endif
+        mesh_tasks_create(MESH_TASK_RX, esp_mesh_p2p_rx_projeto, "MPRX", NULL);
+#if CONFIG_MESH_UPLINK_STREAM
+        mesh_stream_start();
+#endif
+#if CONFIG_MESH_CAPTURE
+        mesh_capture_start();
+#endif
     }
     return ESP_OK;
 }
@@ -388,6 +577,9 @@ void mesh_event_handler(void *arg, esp_event_base_t event_base,
         ESP_LOGI(MESH_TAG, "<MESH_EVENT_CHILD_CONNECTED>aid:%d, "MACSTR"",
                  child_connected->aid,
                  MAC2STR(child_connected->mac));
+#if CONFIG_MESH_ROOT_CAPABLE
+        mesh_nodes_set_child(child_connected->mac, true);
+#endif
     }
     break;
     case MESH_EVENT_CHILD_DISCONNECTED: {
@@ -395,6 +587,9 @@ void mesh_event_handler(void *arg, esp_event_base_t event_base,
         ESP_LOGI(MESH_TAG, "<MESH_EVENT_CHILD_DISCONNECTED>aid:%d, "MACSTR"",
                  child_disconnected->aid,
                  MAC2STR(child_disconnected->mac));
+#if CONFIG_MESH_ROOT_CAPABLE
+        mesh_nodes_set_child(child_disconnected->mac, false);
+#endif
     }
     break;
     case MESH_EVENT_ROUTING_TABLE_ADD: {
@@ -402,6 +597,9 @@ void mesh_event_handler(void *arg, esp_event_base_t event_base,
         ESP_LOGW(MESH_TAG, "<MESH_EVENT_ROUTING_TABLE_ADD>add %d, new:%d",
                  routing_table->rt_size_change,
                  routing_table->rt_size_new);
+#if CONFIG_MESH_ROOT_CAPABLE
+        mesh_api_invalidate_topology();
+#endif
     }
     break;
     case MESH_EVENT_ROUTING_TABLE_REMOVE: {
@@ -409,12 +607,18 @@ void mesh_event_handler(void *arg, esp_event_base_t event_base,
         ESP_LOGW(MESH_TAG, "<MESH_EVENT_ROUTING_TABLE_REMOVE>remove %d, new:%d",
                  routing_table->rt_size_change,
                  routing_table->rt_size_new);
+#if CONFIG_MESH_ROOT_CAPABLE
+        mesh_api_invalidate_topology();
+        mesh_topo_invalidate();
+#endif
     }
     break;
     case MESH_EVENT_NO_PARENT_FOUND: {
         mesh_event_no_parent_found_t *no_parent = (mesh_event_no_parent_found_t *)event_data;
         ESP_LOGI(MESH_TAG, "<MESH_EVENT_NO_PARENT_FOUND>scan times:%d",
                  no_parent->scan_times);
+        mesh_fault_disrupted("no_parent_found");
+        mesh_topo_reparent_done();
     }
     /* TODO handler for the failure */
     break;
@@ -430,7 +634,13 @@ void mesh_event_handler(void *arg, esp_event_base_t event_base,
                  (mesh_layer == 2) ? "<layer2>" : "", MAC2STR(id.addr));
         last_layer = mesh_layer;
         mesh_connected_indicator(mesh_layer);
+#if CONFIG_MESH_ROOT_CAPABLE
+        mesh_api_invalidate_topology();
+#endif
+        mesh_tasks_update_role();
         is_mesh_connected = true;
+        mesh_fault_connected();
+        mesh_topo_reparent_done();
         if (esp_mesh_is_root()) {
             tcpip_adapter_dhcpc_start(TCPIP_ADAPTER_IF_STA);
         }
@@ -444,6 +654,7 @@ void mesh_event_handler(void *arg, esp_event_base_t event_base,
                  disconnected->reason);
         is_mesh_connected = false;
         mesh_disconnected_indicator();
+        mesh_fault_disrupted("parent_disconnected");
         mesh_layer = esp_mesh_get_layer();
     }
     break;
@@ -456,6 +667,10 @@ void mesh_event_handler(void *arg, esp_event_base_t event_base,
                  (mesh_layer == 2) ? "<layer2>" : "");
         last_layer = mesh_layer;
         mesh_connected_indicator(mesh_layer);
+#if CONFIG_MESH_ROOT_CAPABLE
+        mesh_api_invalidate_topology();
+#endif
+        mesh_tasks_update_role();
     }
     break;
     case MESH_EVENT_ROOT_ADDRESS: {
@@ -483,6 +698,13 @@ void mesh_event_handler(void *arg, esp_event_base_t event_base,
                  "<MESH_EVENT_ROOT_SWITCH_REQ>reason:%d, rc_addr:"MACSTR"",
                  switch_req->reason,
                  MAC2STR( switch_req->rc_addr.addr));
+        mesh_fault_disrupted("root_switch");
+#if CONFIG_MESH_ROOT_CAPABLE
+        if (esp_mesh_is_root()) {
+            /* pass queued readings and node state on before stepping down */
+            mesh_handoff_start(&switch_req->rc_addr);
+        }
+#endif
     }
     break;
     case MESH_EVENT_ROOT_SWITCH_ACK: {
@@ -490,6 +712,15 @@ void mesh_event_handler(void *arg, esp_event_base_t event_base,
         mesh_layer = esp_mesh_get_layer();
         esp_mesh_get_parent_bssid(&mesh_parent_addr);
         ESP_LOGI(MESH_TAG, "<MESH_EVENT_ROOT_SWITCH_ACK>layer:%d, parent:"MACSTR"", mesh_layer, MAC2STR(mesh_parent_addr.addr));
+        /* gaps seen from here on are readings lost to the switch */
+        mesh_fault_disrupted("root_takeover");
+        mesh_fault_connected();
+        mesh_tasks_update_role();
+#if CONFIG_MESH_ROOT_CAPABLE
+        if (esp_mesh_is_root()) {
+            mesh_handoff_became_root();
+        }
+#endif
     }
     break;
     case MESH_EVENT_TODS_STATE: {
@@ -556,12 +787,32 @@ void ip_event_handler(void *arg, esp_event_base_t event_base,
 {
     ip_event_got_ip_t *event = (ip_event_got_ip_t *) event_data;
     ESP_LOGI(MESH_TAG, "<IP_EVENT_STA_GOT_IP>IP:%s", ip4addr_ntoa(&event->ip_info.ip));
+#if CONFIG_MESH_LOCAL_API
+    mesh_api_start();
+#endif
+#if CONFIG_MESH_UPLINK_STREAM
+    mesh_stream_kick();
+#elif CONFIG_MESH_UPLINK_HTTP
+    mesh_uplink_prewarm();
+#endif
 }
 
 
 void app_main(void)
 {
     ESP_ERROR_CHECK(mesh_light_init());
+#if CONFIG_MESH_ROOT_CAPABLE
+    ESP_ERROR_CHECK(mesh_nodes_init());
+#endif
+    ESP_ERROR_CHECK(mesh_topo_init());
+    ESP_ERROR_CHECK(mesh_budget_start());
+    ESP_ERROR_CHECK(mesh_fault_start());
+#if CONFIG_MESH_DLOG
+    ESP_ERROR_CHECK(mesh_dlog_init());
+#endif
+#if CONFIG_MESH_DLOG_BENCH
+    mesh_dlog_benchmark();
+#endif
     ESP_ERROR_CHECK(nvs_flash_init());
     /*  tcpip initialization */
     tcpip_adapter_init();
@@ -585,6 +836,13 @@ void app_main(void)
     ESP_ERROR_CHECK(esp_mesh_set_max_layer(CONFIG_MESH_MAX_LAYER));
     ESP_ERROR_CHECK(esp_mesh_set_vote_percentage(1));
     ESP_ERROR_CHECK(esp_mesh_set_ap_assoc_expire(10));
+#if CONFIG_MESH_FIXED_ROOT
+    ESP_ERROR_CHECK(esp_mesh_set_type(MESH_ROOT));
+    ESP_ERROR_CHECK(esp_mesh_fix_root(true));
+#elif !CONFIG_MESH_ROOT_CAPABLE
+    /* a fixed root is designated, this node never votes or takes over */
+    ESP_ERROR_CHECK(esp_mesh_fix_root(true));
+#endif
     mesh_cfg_t cfg = MESH_INIT_CONFIG_DEFAULT();
     /* mesh ID */
     memcpy((uint8_t *) &cfg.mesh_id, MESH_ID, 6);
@@ -605,5 +863,7 @@ void app_main(void)
     ESP_LOGI(MESH_TAG, "mesh starts successfully, heap:%d, %s\n",  esp_get_free_heap_size(),
              esp_mesh_is_root_fixed() ? "root fixed" : "root not fixed");
 
+#if CONFIG_MESH_SENSOR
     DHT11_init(GPIO_NUM_4);
+#endif
 }
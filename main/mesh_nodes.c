@@ -0,0 +1,503 @@
+/* Mesh Root Per-Node State
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <string.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_mesh.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "mesh_nodes.h"
+#include "sdkconfig.h"
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define AGG_EWMA_SHIFT          (3)  /* alpha = 1/8 */
+#define AGG_EWMA_ONE            (256)
+
+/*******************************************************
+ *                Structures
+ *******************************************************/
+typedef struct {
+    uint16_t epoch;         /* bucket number since boot, wraps */
+    uint16_t count;
+    int16_t min;
+    int16_t max;
+    int32_t sum;
+} agg_bucket_t;
+
+typedef struct {
+    int16_t last;
+    int32_t ewma;           /* scaled by AGG_EWMA_ONE */
+    agg_bucket_t short_win[MESH_AGG_SHORT_BUCKETS];
+    agg_bucket_t long_win[MESH_AGG_LONG_BUCKETS];
+} agg_metric_t;
+
+typedef struct {
+    uint8_t addr[6];
+    uint8_t node_id;
+    uint8_t layer;
+    bool has_reading;
+    uint32_t version;       /* bumped on every reading */
+    uint32_t last_seen_s;
+    mesh_seq_window_t dedup;
+    uint8_t self_ap[6];
+    uint8_t parent_ap[6];
+    uint32_t frames;
+    uint32_t link_seen_s;
+    mesh_seq_stats_t seq;
+    agg_metric_t temperature;
+    agg_metric_t humidity;
+} mesh_node_entry_t;
+
+/*******************************************************
+ *                Variable Definitions
+ *******************************************************/
+static const char *NODES_TAG = "mesh_nodes";
+/* hash slots hold index + 1 into the dense entry array, 0 is empty */
+static uint16_t s_slots[MESH_NODES_CAPACITY];
+static mesh_node_entry_t s_nodes[CONFIG_MESH_ROUTE_TABLE_SIZE];
+static int s_node_count = 0;
+static uint32_t s_untracked = 0;
+static uint8_t s_children[CONFIG_MESH_AP_CONNECTIONS][6];
+static bool s_child_used[CONFIG_MESH_AP_CONNECTIONS];
+static mesh_addr_t s_subnet[CONFIG_MESH_ROUTE_TABLE_SIZE];
+static SemaphoreHandle_t s_lock = NULL;
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+static uint32_t nodes_hash(const uint8_t *addr)
+{
+    /* the vendor prefix is shared by every node, hash the low bytes */
+    uint32_t key = ((uint32_t)addr[2] << 24) | (addr[3] << 16) | (addr[4] << 8) | addr[5];
+    return (key * 2654435761u) % MESH_NODES_CAPACITY;
+}
+
+static mesh_node_entry_t *nodes_lookup(const uint8_t *addr, bool create)
+{
+    uint32_t slot = nodes_hash(addr);
+
+    for (int i = 0; i < MESH_NODES_CAPACITY; i++) {
+        if (!s_slots[slot]) {
+            if (!create || s_node_count >= CONFIG_MESH_ROUTE_TABLE_SIZE) {
+                return NULL;
+            }
+            mesh_node_entry_t *entry = &s_nodes[s_node_count++];
+            memset(entry, 0, sizeof(*entry));
+            memcpy(entry->addr, addr, sizeof(entry->addr));
+            s_slots[slot] = s_node_count;
+            return entry;
+        }
+        mesh_node_entry_t *entry = &s_nodes[s_slots[slot] - 1];
+        if (!memcmp(entry->addr, addr, sizeof(entry->addr))) {
+            return entry;
+        }
+        slot = (slot + 1) % MESH_NODES_CAPACITY;
+    }
+    return NULL;
+}
+
+mesh_seq_result_t mesh_nodes_check_seq(const uint8_t *addr, uint16_t session, uint32_t seq,
+                                       uint8_t layer)
+{
+    mesh_seq_result_t result;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    mesh_node_entry_t *entry = nodes_lookup(addr, true);
+    if (!entry) {
+        s_untracked++;
+        xSemaphoreGive(s_lock);
+        return MESH_SEQ_UNTRACKED;
+    }
+    entry->layer = layer;
+    result = mesh_seq_check(&entry->dedup, &entry->seq, session, seq);
+    xSemaphoreGive(s_lock);
+    return result;
+}
+
+esp_err_t mesh_nodes_get_seq_stats(const uint8_t *addr, mesh_seq_stats_t *stats)
+{
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    mesh_node_entry_t *entry = nodes_lookup(addr, false);
+    if (entry) {
+        *stats = entry->seq;
+        err = ESP_OK;
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+static uint32_t agg_now_s(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000000);
+}
+
+static void agg_bucket_add(agg_bucket_t *win, int buckets, uint32_t bucket_s,
+                           uint32_t now_s, int value)
+{
+    uint16_t epoch = now_s / bucket_s;
+    agg_bucket_t *bucket = &win[(now_s / bucket_s) % buckets];
+
+    if (bucket->epoch != epoch || !bucket->count) {
+        /* slot last used a full window ago, start it over */
+        bucket->epoch = epoch;
+        bucket->count = 0;
+        bucket->sum = 0;
+        bucket->min = value;
+        bucket->max = value;
+    }
+    if (bucket->count < UINT16_MAX) {
+        bucket->count++;
+        bucket->sum += value;
+    }
+    if (value < bucket->min) {
+        bucket->min = value;
+    }
+    if (value > bucket->max) {
+        bucket->max = value;
+    }
+}
+
+static void agg_metric_add(agg_metric_t *metric, uint32_t now_s, int value, bool first)
+{
+    metric->last = value;
+    if (first) {
+        metric->ewma = value * AGG_EWMA_ONE;
+    } else {
+        metric->ewma += (value * AGG_EWMA_ONE - metric->ewma) >> AGG_EWMA_SHIFT;
+    }
+    agg_bucket_add(metric->short_win, MESH_AGG_SHORT_BUCKETS, MESH_AGG_SHORT_BUCKET_S, now_s, value);
+    agg_bucket_add(metric->long_win, MESH_AGG_LONG_BUCKETS, MESH_AGG_LONG_BUCKET_S, now_s, value);
+}
+
+static void agg_window(const agg_bucket_t *win, int buckets, uint32_t bucket_s,
+                       uint32_t now_s, mesh_agg_window_t *out)
+{
+    uint16_t epoch = now_s / bucket_s;
+    int64_t sum = 0;
+
+    memset(out, 0, sizeof(*out));
+    for (int i = 0; i < buckets; i++) {
+        const agg_bucket_t *bucket = &win[i];
+        if (!bucket->count || (uint16_t)(epoch - bucket->epoch) >= buckets) {
+            continue;
+        }
+        if (!out->count || bucket->min < out->min) {
+            out->min = bucket->min;
+        }
+        if (!out->count || bucket->max > out->max) {
+            out->max = bucket->max;
+        }
+        out->count += bucket->count;
+        sum += bucket->sum;
+    }
+    out->mean_x100 = out->count ? (int32_t)(sum * 100 / out->count) : 0;
+}
+
+static void agg_metric_summary(const agg_metric_t *metric, uint32_t now_s,
+                               mesh_metric_summary_t *out)
+{
+    out->last = metric->last;
+    out->ewma_x100 = metric->ewma * 100 / AGG_EWMA_ONE;
+    agg_window(metric->short_win, MESH_AGG_SHORT_BUCKETS, MESH_AGG_SHORT_BUCKET_S, now_s, &out->short_win);
+    agg_window(metric->long_win, MESH_AGG_LONG_BUCKETS, MESH_AGG_LONG_BUCKET_S, now_s, &out->long_win);
+}
+
+static void node_summary(const mesh_node_entry_t *entry, uint32_t now_s, mesh_node_summary_t *out)
+{
+    memcpy(out->addr, entry->addr, sizeof(out->addr));
+    out->node_id = entry->node_id;
+    out->layer = entry->layer;
+    out->has_reading = entry->has_reading;
+    out->last_seen_s = entry->last_seen_s;
+    out->age_s = now_s - entry->last_seen_s;
+    agg_metric_summary(&entry->temperature, now_s, &out->temperature);
+    agg_metric_summary(&entry->humidity, now_s, &out->humidity);
+}
+
+esp_err_t mesh_nodes_update(const uint8_t *addr, uint8_t node_id, uint8_t layer,
+                            int temperature, int humidity)
+{
+    uint32_t now_s = agg_now_s();
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    mesh_node_entry_t *entry = nodes_lookup(addr, true);
+    if (!entry) {
+        xSemaphoreGive(s_lock);
+        return ESP_ERR_NO_MEM;
+    }
+    bool first = !entry->has_reading;
+    entry->has_reading = true;
+    entry->node_id = node_id;
+    entry->layer = layer;
+    entry->last_seen_s = now_s;
+    entry->version++;
+    agg_metric_add(&entry->temperature, now_s, temperature, first);
+    agg_metric_add(&entry->humidity, now_s, humidity, first);
+    xSemaphoreGive(s_lock);
+    return ESP_OK;
+}
+
+esp_err_t mesh_nodes_get_summary(const uint8_t *addr, mesh_node_summary_t *summary)
+{
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    mesh_node_entry_t *entry = nodes_lookup(addr, false);
+    if (entry) {
+        node_summary(entry, agg_now_s(), summary);
+        err = ESP_OK;
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+int mesh_nodes_get_summaries(int start, mesh_node_summary_t *summaries, int max)
+{
+    uint32_t now_s = agg_now_s();
+    int n = 0;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (int i = start; i < s_node_count && n < max; i++) {
+        node_summary(&s_nodes[i], now_s, &summaries[n++]);
+    }
+    xSemaphoreGive(s_lock);
+    return n;
+}
+
+int mesh_nodes_get_changed(int index, uint32_t *version, mesh_node_summary_t *summary)
+{
+    int changed = 0;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (index >= s_node_count) {
+        changed = -1;
+    } else if (s_nodes[index].version != *version) {
+        *version = s_nodes[index].version;
+        node_summary(&s_nodes[index], agg_now_s(), summary);
+        changed = 1;
+    }
+    xSemaphoreGive(s_lock);
+    return changed;
+}
+
+void mesh_nodes_note_link(const uint8_t *addr, const uint8_t *self_ap, const uint8_t *parent_ap)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    mesh_node_entry_t *entry = nodes_lookup(addr, true);
+    if (entry) {
+        memcpy(entry->self_ap, self_ap, sizeof(entry->self_ap));
+        memcpy(entry->parent_ap, parent_ap, sizeof(entry->parent_ap));
+        entry->frames++;
+        entry->link_seen_s = agg_now_s();
+    }
+    xSemaphoreGive(s_lock);
+}
+
+int mesh_nodes_get_links(int start, mesh_node_link_t *links, int max)
+{
+    uint32_t now_s = agg_now_s();
+    int n = 0;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (int i = start; i < s_node_count && n < max; i++) {
+        const mesh_node_entry_t *entry = &s_nodes[i];
+        mesh_node_link_t *link = &links[n++];
+        memcpy(link->addr, entry->addr, sizeof(link->addr));
+        memcpy(link->self_ap, entry->self_ap, sizeof(link->self_ap));
+        memcpy(link->parent_ap, entry->parent_ap, sizeof(link->parent_ap));
+        link->layer = entry->layer;
+        link->frames = entry->frames;
+        link->age_s = entry->frames ? now_s - entry->link_seen_s : UINT32_MAX;
+    }
+    xSemaphoreGive(s_lock);
+    return n;
+}
+
+int mesh_nodes_export(int start, mesh_node_state_t *states, int max)
+{
+    uint32_t now_s = agg_now_s();
+    int n = 0;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (int i = start; i < s_node_count && n < max; i++) {
+        const mesh_node_entry_t *entry = &s_nodes[i];
+        mesh_node_state_t *state = &states[n++];
+        memcpy(state->addr, entry->addr, sizeof(state->addr));
+        state->node_id = entry->node_id;
+        state->layer = entry->layer;
+        state->high_seq = entry->dedup.high_seq;
+        state->window = entry->dedup.window;
+        state->session = entry->dedup.session;
+        state->received = entry->seq.received;
+        state->lost = entry->seq.lost + entry->seq.late;
+        state->age_s = entry->has_reading ? now_s - entry->last_seen_s : UINT32_MAX;
+        state->temperature = entry->temperature.last;
+        state->humidity = entry->humidity.last;
+        state->temperature_ewma = entry->temperature.ewma;
+        state->humidity_ewma = entry->humidity.ewma;
+    }
+    xSemaphoreGive(s_lock);
+    return n;
+}
+
+/* Merge state from the previous root, frames seen by either root count as received. */
+esp_err_t mesh_nodes_import(const mesh_node_state_t *state)
+{
+    uint32_t now_s = agg_now_s();
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    mesh_node_entry_t *entry = nodes_lookup(state->addr, true);
+    if (!entry) {
+        xSemaphoreGive(s_lock);
+        return ESP_ERR_NO_MEM;
+    }
+    mesh_seq_window_t window = {
+        .high_seq = state->high_seq,
+        .window = state->window,
+        .session = state->session,
+    };
+    mesh_seq_merge(&entry->dedup, &window);
+    entry->seq.received += state->received;
+    entry->seq.lost += state->lost;
+    if (!entry->has_reading && state->age_s != UINT32_MAX) {
+        entry->has_reading = true;
+        entry->node_id = state->node_id;
+        entry->layer = state->layer;
+        entry->last_seen_s = now_s > state->age_s ? now_s - state->age_s : 0;
+        entry->version++;
+        entry->temperature.last = state->temperature;
+        entry->temperature.ewma = state->temperature_ewma;
+        entry->humidity.last = state->humidity;
+        entry->humidity.ewma = state->humidity_ewma;
+    }
+    xSemaphoreGive(s_lock);
+    return ESP_OK;
+}
+
+static void seq_stats_add(mesh_seq_stats_t *sum, const mesh_seq_stats_t *stats)
+{
+    sum->received += stats->received;
+    sum->duplicates += stats->duplicates;
+    sum->reordered += stats->reordered;
+    sum->lost += stats->lost;
+    sum->late += stats->late;
+    sum->restarts += stats->restarts;
+}
+
+esp_err_t mesh_nodes_get_subtree_seq_stats(const mesh_addr_t *child, mesh_seq_stats_t *stats,
+                                           int *nodes)
+{
+    int num = 0;
+
+    memset(stats, 0, sizeof(*stats));
+    *nodes = 0;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    esp_err_t err = esp_mesh_get_subnet_nodes_num(child, &num);
+    if (err == ESP_OK && num > CONFIG_MESH_ROUTE_TABLE_SIZE) {
+        num = CONFIG_MESH_ROUTE_TABLE_SIZE;
+    }
+    if (err == ESP_OK && num > 0) {
+        err = esp_mesh_get_subnet_nodes_list(child, s_subnet, num);
+    }
+    for (int i = 0; err == ESP_OK && i < num; i++) {
+        mesh_node_entry_t *entry = nodes_lookup(s_subnet[i].addr, false);
+        if (entry) {
+            seq_stats_add(stats, &entry->seq);
+            (*nodes)++;
+        }
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+void mesh_nodes_set_child(const uint8_t *addr, bool connected)
+{
+    int free_slot = -1;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (int i = 0; i < CONFIG_MESH_AP_CONNECTIONS; i++) {
+        if (s_child_used[i] && !memcmp(s_children[i], addr, 6)) {
+            s_child_used[i] = connected;
+            xSemaphoreGive(s_lock);
+            return;
+        }
+        if (!s_child_used[i] && free_slot < 0) {
+            free_slot = i;
+        }
+    }
+    if (connected && free_slot >= 0) {
+        memcpy(s_children[free_slot], addr, 6);
+        s_child_used[free_slot] = true;
+    }
+    xSemaphoreGive(s_lock);
+}
+
+int mesh_nodes_get_total_seq_stats(mesh_seq_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (int i = 0; i < s_node_count; i++) {
+        seq_stats_add(stats, &s_nodes[i].seq);
+    }
+    int nodes = s_node_count;
+    xSemaphoreGive(s_lock);
+    return nodes;
+}
+
+static uint32_t permille(uint32_t part, uint32_t total)
+{
+    return total ? (uint32_t)((uint64_t)part * 1000 / total) : 0;
+}
+
+void mesh_nodes_log_seq_stats(void)
+{
+    mesh_seq_stats_t total = { 0, };
+    mesh_seq_stats_t stats;
+    mesh_addr_t child;
+    int nodes;
+
+    int node_count = mesh_nodes_get_total_seq_stats(&total);
+    ESP_LOGI(NODES_TAG, "[SEQ nodes:%d untracked:%u] rx:%u dup:%u late:%u restarts:%u loss:%u.%u%% reorder:%u.%u%%",
+             node_count, s_untracked, total.received, total.duplicates, total.late, total.restarts,
+             permille(total.lost, total.received + total.lost) / 10,
+             permille(total.lost, total.received + total.lost) % 10,
+             permille(total.reordered, total.received) / 10,
+             permille(total.reordered, total.received) % 10);
+
+    for (int i = 0; i < CONFIG_MESH_AP_CONNECTIONS; i++) {
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        bool used = s_child_used[i];
+        memcpy(child.addr, s_children[i], 6);
+        xSemaphoreGive(s_lock);
+        if (!used || mesh_nodes_get_subtree_seq_stats(&child, &stats, &nodes) != ESP_OK) {
+            continue;
+        }
+        ESP_LOGI(NODES_TAG, "[SEQ subtree "MACSTR" nodes:%d] rx:%u lost:%u loss:%u.%u%% reorder:%u.%u%%",
+                 MAC2STR(child.addr), nodes, stats.received, stats.lost,
+                 permille(stats.lost, stats.received + stats.lost) / 10,
+                 permille(stats.lost, stats.received + stats.lost) % 10,
+                 permille(stats.reordered, stats.received) / 10,
+                 permille(stats.reordered, stats.received) % 10);
+    }
+}
+
+esp_err_t mesh_nodes_init(void)
+{
+    if (s_lock) {
+        return ESP_OK;
+    }
+    s_lock = xSemaphoreCreateMutex();
+    return s_lock ? ESP_OK : ESP_ERR_NO_MEM;
+}
@@ -0,0 +1,77 @@
+/* Mesh Adaptive Sampling Rate
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <string.h>
+#include "mesh_rate.h"
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define RATE_EWMA_SHIFT         (2)     /* alpha = 1/4, a burst shows after one or two readings */
+/* DHT11 accuracy is +-2 C and +-5 %RH, weigh humidity changes accordingly */
+#define RATE_HUMIDITY_NUM       (2)
+#define RATE_HUMIDITY_DEN       (5)
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+static uint32_t rate_abs(int v)
+{
+    return v < 0 ? -v : v;
+}
+
+void mesh_rate_init(mesh_rate_t *rate, const mesh_rate_config_t *config)
+{
+    memset(rate, 0, sizeof(*rate));
+    rate->config = *config;
+    if (rate->config.max_interval_ms < rate->config.min_interval_ms) {
+        rate->config.max_interval_ms = rate->config.min_interval_ms;
+    }
+    if (rate->config.busy_x100 <= rate->config.calm_x100) {
+        rate->config.busy_x100 = rate->config.calm_x100 + 1;
+    }
+    /* start fast, the first readings show what the room is like */
+    rate->interval_ms = rate->config.min_interval_ms;
+}
+
+/* Feed a reading that was sent, elapsed_ms after the previous one. Returns the
+ * time until the next reading, never shorter than floor_ms set by the root. */
+uint32_t mesh_rate_update(mesh_rate_t *rate, int temperature, int humidity, uint32_t elapsed_ms,
+                          uint32_t floor_ms)
+{
+    const mesh_rate_config_t *cfg = &rate->config;
+
+    if (rate->has_last && elapsed_ms) {
+        uint32_t dt = rate_abs(temperature - rate->last_temperature) * 100;
+        uint32_t dh = rate_abs(humidity - rate->last_humidity) * 100 * RATE_HUMIDITY_NUM / RATE_HUMIDITY_DEN;
+        uint32_t per_min = (uint64_t)(dt > dh ? dt : dh) * 60000 / elapsed_ms;
+        int32_t diff = (int32_t)per_min - (int32_t)rate->volatility_x100;
+        rate->volatility_x100 += diff >> RATE_EWMA_SHIFT;
+    }
+    rate->has_last = true;
+    rate->last_temperature = temperature;
+    rate->last_humidity = humidity;
+
+    uint32_t vol = rate->volatility_x100;
+    uint32_t interval;
+    if (vol <= cfg->calm_x100) {
+        interval = cfg->max_interval_ms;
+    } else if (vol >= cfg->busy_x100) {
+        interval = cfg->min_interval_ms;
+    } else {
+        uint32_t span = cfg->max_interval_ms - cfg->min_interval_ms;
+        interval = cfg->max_interval_ms
+                   - (uint64_t)span * (vol - cfg->calm_x100) / (cfg->busy_x100 - cfg->calm_x100);
+    }
+    if (interval < floor_ms) {
+        interval = floor_ms;
+    }
+    rate->interval_ms = interval;
+    return interval;
+}
@@ -0,0 +1,86 @@
+/* Mesh Recovery Tracking
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include "mesh_recovery.h"
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+static uint32_t recovery_rate(const mesh_recovery_t *rec, int seconds)
+{
+    uint32_t sum = 0;
+    for (int i = 0; i < seconds; i++) {
+        sum += rec->rx_per_s[(rec->slot + MESH_RECOVERY_RATE_SECONDS - 1 - i) % MESH_RECOVERY_RATE_SECONDS];
+    }
+    return sum;
+}
+
+/* Called once a second with the running count of frames received. */
+void mesh_recovery_sample(mesh_recovery_t *rec, uint32_t rx_count)
+{
+    rec->rx_per_s[rec->slot] = rx_count - rec->rx_last;
+    rec->slot = (rec->slot + 1) % MESH_RECOVERY_RATE_SECONDS;
+    rec->rx_last = rx_count;
+    rec->samples++;
+}
+
+/* Opens an event, false while one is open already. */
+bool mesh_recovery_start(mesh_recovery_t *rec, int64_t now_us)
+{
+    if (rec->open) {
+        return false;
+    }
+    rec->open = true;
+    rec->connected = false;
+    rec->throughput_back = false;
+    rec->samples = 0;
+    rec->start_us = now_us;
+    rec->connected_us = 0;
+    rec->throughput_ms = 0;
+    rec->baseline = recovery_rate(rec, MESH_RECOVERY_RATE_SECONDS);
+    return true;
+}
+
+/* First reconnect of the open event, ms is the time it took. */
+bool mesh_recovery_connected(mesh_recovery_t *rec, int64_t now_us, uint32_t *ms)
+{
+    if (!rec->open || rec->connected) {
+        return false;
+    }
+    rec->connected = true;
+    rec->connected_us = now_us;
+    *ms = (now_us - rec->start_us) / 1000;
+    return true;
+}
+
+/* Called every tick after mesh_recovery_sample(), returns MESH_RECOVERY_* bits. */
+int mesh_recovery_track(mesh_recovery_t *rec, int64_t now_us)
+{
+    int result = 0;
+
+    if (!rec->open) {
+        return 0;
+    }
+    /* recovered once the last two seconds are back at the baseline rate, the
+     * first sample after the start still holds readings from before it */
+    if (!rec->throughput_back && rec->baseline && rec->samples > 2
+            && recovery_rate(rec, 2) * MESH_RECOVERY_RATE_SECONDS * 100
+               >= rec->baseline * 2 * MESH_RECOVERY_PCT) {
+        rec->throughput_back = true;
+        rec->throughput_ms = (now_us - rec->start_us) / 1000;
+        result |= MESH_RECOVERY_THROUGHPUT;
+    }
+    int64_t age_us = now_us - rec->start_us;
+    if (age_us < MESH_RECOVERY_SETTLE_S * 1000000LL
+            || (!rec->connected && age_us < MESH_RECOVERY_GIVE_UP_S * 1000000LL)) {
+        return result;
+    }
+    rec->open = false;
+    return result | MESH_RECOVERY_SETTLED;
+}
@@ -0,0 +1,93 @@
+/* Mesh Sequence Dedup Window
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include "mesh_seq.h"
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+static void seq_reset(mesh_seq_window_t *win, uint16_t session, uint32_t seq)
+{
+    win->session = session;
+    win->high_seq = seq;
+    /* nothing before the first frame counts as missing */
+    win->window = ~0ULL;
+}
+
+/* Move the window forward, returns how many sequences left it unseen. */
+static uint32_t seq_slide(mesh_seq_window_t *win, uint32_t shift)
+{
+    uint32_t lost;
+
+    if (shift >= MESH_SEQ_WINDOW) {
+        lost = MESH_SEQ_WINDOW - __builtin_popcountll(win->window) + (shift - MESH_SEQ_WINDOW);
+        win->window = 0;
+    } else {
+        lost = shift - __builtin_popcountll(win->window >> (MESH_SEQ_WINDOW - shift));
+        win->window <<= shift;
+    }
+    return lost;
+}
+
+mesh_seq_result_t mesh_seq_check(mesh_seq_window_t *win, mesh_seq_stats_t *stats,
+                                 uint16_t session, uint32_t seq)
+{
+    mesh_seq_result_t result;
+
+    if (!win->window) {
+        /* first frame from this node */
+        seq_reset(win, session, seq);
+        result = MESH_SEQ_NEW;
+    } else if (session != win->session) {
+        /* the node rebooted, wherever its sequence restarted from */
+        stats->restarts++;
+        seq_reset(win, session, seq);
+        result = MESH_SEQ_RESTART;
+    } else if (seq > win->high_seq) {
+        stats->lost += seq_slide(win, seq - win->high_seq);
+        win->window |= 1;
+        win->high_seq = seq;
+        result = MESH_SEQ_NEW;
+    } else if (win->high_seq - seq >= MESH_SEQ_WINDOW) {
+        stats->late++;
+        result = MESH_SEQ_DUPLICATE;
+    } else {
+        uint64_t bit = 1ULL << (win->high_seq - seq);
+        if (win->window & bit) {
+            stats->duplicates++;
+            result = MESH_SEQ_DUPLICATE;
+        } else {
+            win->window |= bit;
+            stats->reordered++;
+            result = MESH_SEQ_REORDERED;
+        }
+    }
+    if (result != MESH_SEQ_DUPLICATE) {
+        stats->received++;
+    }
+    return result;
+}
+
+/* Fold in a window kept elsewhere (the previous root), frames seen by either count as received. */
+void mesh_seq_merge(mesh_seq_window_t *win, const mesh_seq_window_t *other)
+{
+    if (!other->window) {
+        return;
+    }
+    if (!win->window || other->session != win->session) {
+        /* the other root followed the node for longer, its session is the current one */
+        *win = *other;
+    } else if (other->high_seq > win->high_seq) {
+        uint32_t shift = other->high_seq - win->high_seq;
+        win->window = (shift >= MESH_SEQ_WINDOW ? 0 : win->window << shift) | other->window;
+        win->high_seq = other->high_seq;
+    } else if (win->high_seq - other->high_seq < MESH_SEQ_WINDOW) {
+        win->window |= other->window >> (win->high_seq - other->high_seq);
+    }
+}
@@ -0,0 +1,377 @@
+/* Mesh Binary Uplink Stream
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_mesh.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "lwip/sockets.h"
+#include "lwip/netdb.h"
+#include "mesh_fault.h"
+#include "mesh_stream.h"
+#include "mesh_tasks.h"
+#include "sdkconfig.h"
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define STREAM_RING_SIZE        (CONFIG_MESH_STREAM_RING_SIZE)
+#define STREAM_BATCH            (CONFIG_MESH_STREAM_BATCH)
+#define STREAM_FLUSH_MS         (CONFIG_MESH_STREAM_FLUSH_MS)
+#define STREAM_HDR_SIZE         (3)
+#define STREAM_RECORD_WIRE_SIZE (STREAM_HDR_SIZE + sizeof(mesh_stream_record_t))
+#define STREAM_IO_TIMEOUT_S     (5)
+#define STREAM_BACKOFF_MIN_MS   (500)
+#define STREAM_BACKOFF_MAX_MS   (30000)
+
+/*******************************************************
+ *                Variable Definitions
+ *******************************************************/
+static const char *STREAM_TAG = "mesh_stream";
+/* records are kept until acknowledged, slot = seq % STREAM_RING_SIZE */
+static mesh_stream_record_t s_ring[STREAM_RING_SIZE];
+static uint8_t s_tx_buf[STREAM_BATCH * STREAM_RECORD_WIRE_SIZE];
+static uint8_t s_rx_buf[64];
+static int s_rx_len = 0;
+static uint32_t s_session = 0;
+static uint32_t s_next_seq = 1;   /* sequence of the next pushed record */
+static uint32_t s_tail_seq = 1;   /* oldest record still held */
+static uint32_t s_sent_seq = 0;   /* last record written on this connection */
+static uint32_t s_high_seq = 0;   /* last record ever written */
+static uint32_t s_acked_seq = 0;  /* last record acknowledged by the collector */
+static SemaphoreHandle_t s_lock = NULL;
+static TaskHandle_t s_task = NULL;
+static mesh_stream_stats_t s_stats;
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+static void stream_put_header(uint8_t *buf, uint16_t body_len, uint8_t type)
+{
+    uint16_t len = body_len + 1;
+    memcpy(buf, &len, sizeof(len));
+    buf[2] = type;
+}
+
+static esp_err_t stream_send_all(int sock, const uint8_t *buf, size_t len)
+{
+    while (len) {
+        int n = send(sock, buf, len, 0);
+        if (n < 0) {
+            ESP_LOGE(STREAM_TAG, "send failed, errno:%d", errno);
+            return ESP_FAIL;
+        }
+        buf += n;
+        len -= n;
+    }
+    return ESP_OK;
+}
+
+static void stream_ack_locked(uint32_t seq)
+{
+    if (seq >= s_next_seq || seq <= s_acked_seq) {
+        return;
+    }
+    s_stats.acked += seq - s_acked_seq;
+    s_acked_seq = seq;
+    if (s_tail_seq <= seq) {
+        s_tail_seq = seq + 1;
+    }
+}
+
+/* Parse whatever the collector has sent so far. With wait set, block
+ * (bounded by SO_RCVTIMEO) until at least one ack has been seen. */
+static esp_err_t stream_read_acks(int sock, bool wait)
+{
+    bool got_ack = false;
+
+    do {
+        int n = recv(sock, s_rx_buf + s_rx_len, sizeof(s_rx_buf) - s_rx_len,
+                     wait ? 0 : MSG_DONTWAIT);
+        if (n == 0) {
+            ESP_LOGW(STREAM_TAG, "collector closed the connection");
+            return ESP_FAIL;
+        }
+        if (n < 0) {
+            if (!wait && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                return ESP_OK;
+            }
+            ESP_LOGE(STREAM_TAG, "recv failed, errno:%d", errno);
+            return ESP_FAIL;
+        }
+        s_rx_len += n;
+
+        int off = 0;
+        while (s_rx_len - off >= STREAM_HDR_SIZE) {
+            uint16_t len;
+            memcpy(&len, s_rx_buf + off, sizeof(len));
+            if (len == 0 || len + 2 > sizeof(s_rx_buf)) {
+                ESP_LOGE(STREAM_TAG, "bad message length:%d", len);
+                return ESP_FAIL;
+            }
+            if (s_rx_len - off < len + 2) {
+                break;
+            }
+            if (s_rx_buf[off + 2] == MESH_STREAM_MSG_ACK
+                    && len - 1 >= sizeof(mesh_stream_ack_t)) {
+                mesh_stream_ack_t ack;
+                memcpy(&ack, s_rx_buf + off + STREAM_HDR_SIZE, sizeof(ack));
+                xSemaphoreTake(s_lock, portMAX_DELAY);
+                stream_ack_locked(ack.seq);
+                xSemaphoreGive(s_lock);
+                got_ack = true;
+            }
+            off += len + 2;
+        }
+        memmove(s_rx_buf, s_rx_buf + off, s_rx_len - off);
+        s_rx_len -= off;
+    } while (wait && !got_ack);
+
+    return ESP_OK;
+}
+
+static int stream_connect(void)
+{
+    struct addrinfo hints = {
+        .ai_family = AF_INET,
+        .ai_socktype = SOCK_STREAM,
+    };
+    struct addrinfo *res = NULL;
+    char port[8];
+
+    snprintf(port, sizeof(port), "%d", CONFIG_MESH_STREAM_PORT);
+    if (getaddrinfo(CONFIG_MESH_STREAM_HOST, port, &hints, &res) != 0 || !res) {
+        ESP_LOGE(STREAM_TAG, "cannot resolve %s", CONFIG_MESH_STREAM_HOST);
+        return -1;
+    }
+    int sock = socket(res->ai_family, res->ai_socktype, 0);
+    if (sock < 0) {
+        freeaddrinfo(res);
+        return -1;
+    }
+    /* batches are coalesced here, so let every write go out immediately */
+    int nodelay = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    struct timeval tv = { .tv_sec = STREAM_IO_TIMEOUT_S, .tv_usec = 0 };
+    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    if (connect(sock, res->ai_addr, res->ai_addrlen) != 0) {
+        ESP_LOGE(STREAM_TAG, "connect to %s:%s failed, errno:%d",
+                 CONFIG_MESH_STREAM_HOST, port, errno);
+        freeaddrinfo(res);
+        close(sock);
+        return -1;
+    }
+    freeaddrinfo(res);
+
+    uint8_t msg[STREAM_HDR_SIZE + sizeof(mesh_stream_hello_t)];
+    mesh_stream_hello_t hello = {
+        .magic = MESH_STREAM_MAGIC,
+        .version = MESH_STREAM_VERSION,
+        .session = s_session,
+    };
+    esp_read_mac(hello.root, ESP_MAC_WIFI_STA);
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    hello.tail_seq = s_tail_seq;
+    xSemaphoreGive(s_lock);
+    stream_put_header(msg, sizeof(hello), MESH_STREAM_MSG_HELLO);
+    memcpy(msg + STREAM_HDR_SIZE, &hello, sizeof(hello));
+
+    /* the first ack tells where the collector wants us to resume */
+    s_rx_len = 0;
+    if (stream_send_all(sock, msg, sizeof(msg)) != ESP_OK
+            || stream_read_acks(sock, true) != ESP_OK) {
+        close(sock);
+        return -1;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_sent_seq = s_acked_seq > s_tail_seq - 1 ? s_acked_seq : s_tail_seq - 1;
+    ESP_LOGI(STREAM_TAG, "connected, resume after seq:%u, pending:%u",
+             s_sent_seq, s_next_seq - 1 - s_sent_seq);
+    xSemaphoreGive(s_lock);
+    return sock;
+}
+
+/* Write out everything pending, at most STREAM_BATCH records per write. */
+static esp_err_t stream_flush(int sock)
+{
+    while (true) {
+        size_t len = 0;
+        uint32_t seq;
+
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        seq = s_sent_seq + 1 > s_tail_seq ? s_sent_seq + 1 : s_tail_seq;
+        for (; seq < s_next_seq && len < sizeof(s_tx_buf); seq++) {
+            stream_put_header(s_tx_buf + len, sizeof(mesh_stream_record_t), MESH_STREAM_MSG_RECORD);
+            memcpy(s_tx_buf + len + STREAM_HDR_SIZE, &s_ring[seq % STREAM_RING_SIZE],
+                   sizeof(mesh_stream_record_t));
+            len += STREAM_RECORD_WIRE_SIZE;
+        }
+        xSemaphoreGive(s_lock);
+
+        if (!len) {
+            return ESP_OK;
+        }
+        if (stream_send_all(sock, s_tx_buf, len) != ESP_OK) {
+            return ESP_FAIL;
+        }
+
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        uint32_t last = seq - 1;
+        uint32_t count = len / STREAM_RECORD_WIRE_SIZE;
+        s_stats.writes++;
+        s_stats.sent += count;
+        if (last - count < s_high_seq) {
+            s_stats.resent += (s_high_seq < last ? s_high_seq : last) - (last - count);
+        }
+        if (last > s_high_seq) {
+            s_high_seq = last;
+        }
+        if (last > s_sent_seq) {
+            s_sent_seq = last;
+        }
+        xSemaphoreGive(s_lock);
+    }
+}
+
+static void mesh_stream_task(void *arg)
+{
+    uint32_t backoff_ms = STREAM_BACKOFF_MIN_MS;
+
+    while (true) {
+        if (!esp_mesh_is_root() || mesh_fault_uplink_down()) {
+            /* mesh_stream_kick wakes us as soon as this node becomes root */
+            ulTaskNotifyTake(pdTRUE, 1000 / portTICK_PERIOD_MS);
+            continue;
+        }
+        int sock = stream_connect();
+        if (sock < 0) {
+            vTaskDelay((backoff_ms + esp_random() % backoff_ms) / portTICK_PERIOD_MS);
+            backoff_ms = backoff_ms * 2 > STREAM_BACKOFF_MAX_MS ? STREAM_BACKOFF_MAX_MS : backoff_ms * 2;
+            continue;
+        }
+        backoff_ms = STREAM_BACKOFF_MIN_MS;
+        s_stats.connects++;
+
+        while (esp_mesh_is_root() && !mesh_fault_uplink_down()) {
+            /* woken early by mesh_stream_push once a full batch is waiting */
+            ulTaskNotifyTake(pdTRUE, STREAM_FLUSH_MS / portTICK_PERIOD_MS);
+            int64_t busy_start = esp_timer_get_time();
+            if (stream_flush(sock) != ESP_OK || stream_read_acks(sock, false) != ESP_OK) {
+                break;
+            }
+            mesh_tasks_note_work(MESH_TASK_UPLINK, busy_start);
+        }
+        close(sock);
+        s_stats.disconnects++;
+
+        /* unacknowledged records go out again on the next connection */
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        s_sent_seq = s_acked_seq;
+        xSemaphoreGive(s_lock);
+    }
+}
+
+esp_err_t mesh_stream_push(const uint8_t *addr, uint16_t node_session, uint32_t node_seq,
+                           uint8_t node_id, uint8_t layer, int8_t temperature, uint8_t humidity)
+{
+    if (!s_lock) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (s_next_seq - s_tail_seq >= STREAM_RING_SIZE) {
+        /* collector is not keeping up, drop the oldest record */
+        s_tail_seq++;
+        s_stats.dropped++;
+    }
+    mesh_stream_record_t *rec = &s_ring[s_next_seq % STREAM_RING_SIZE];
+    rec->seq = s_next_seq;
+    rec->timestamp_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    memcpy(rec->addr, addr, sizeof(rec->addr));
+    rec->node_seq = node_seq;
+    rec->node_session = node_session;
+    rec->node_id = node_id;
+    rec->layer = layer;
+    rec->temperature = temperature;
+    rec->humidity = humidity;
+    s_next_seq++;
+    s_stats.pushed++;
+    bool batch_ready = s_next_seq - 1 - s_sent_seq >= STREAM_BATCH;
+    xSemaphoreGive(s_lock);
+
+    if (batch_ready) {
+        xTaskNotifyGive(s_task);
+    }
+    return ESP_OK;
+}
+
+int mesh_stream_take_pending(mesh_stream_record_t *records, int max)
+{
+    int n = 0;
+
+    if (!s_lock) {
+        return 0;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    uint32_t seq = s_acked_seq + 1 > s_tail_seq ? s_acked_seq + 1 : s_tail_seq;
+    for (; seq < s_next_seq && n < max; seq++) {
+        records[n++] = s_ring[seq % STREAM_RING_SIZE];
+    }
+    /* handed over, no longer ours to deliver */
+    s_tail_seq = seq;
+    if (s_sent_seq < seq - 1) {
+        s_sent_seq = seq - 1;
+    }
+    s_stats.handed_off += n;
+    xSemaphoreGive(s_lock);
+    return n;
+}
+
+void mesh_stream_kick(void)
+{
+    if (s_task) {
+        xTaskNotifyGive(s_task);
+    }
+}
+
+void mesh_stream_get_stats(mesh_stream_stats_t *stats)
+{
+    if (!s_lock) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *stats = s_stats;
+    xSemaphoreGive(s_lock);
+}
+
+esp_err_t mesh_stream_start(void)
+{
+    if (s_lock) {
+        return ESP_OK;
+    }
+    s_lock = xSemaphoreCreateMutex();
+    if (!s_lock) {
+        return ESP_ERR_NO_MEM;
+    }
+    s_session = esp_random();
+    if (mesh_tasks_create(MESH_TASK_UPLINK, mesh_stream_task, "MSUP", &s_task) != ESP_OK) {
+        vSemaphoreDelete(s_lock);
+        s_lock = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,133 @@
+/* Mesh Task Topology
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <string.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_mesh.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "mesh_tasks.h"
+#include "sdkconfig.h"
+
+/*******************************************************
+ *                Structures
+ *******************************************************/
+typedef struct {
+    int core;
+    uint32_t stack;
+    int root_prio;
+    int node_prio;
+} task_config_t;
+
+/*******************************************************
+ *                Variable Definitions
+ *******************************************************/
+static const char *TASKS_TAG = "mesh_tasks";
+static const task_config_t s_config[MESH_TASK_MAX] = {
+    [MESH_TASK_RX] = {
+        CONFIG_MESH_TASK_RX_CORE, CONFIG_MESH_TASK_RX_STACK,
+        CONFIG_MESH_TASK_RX_PRIO, CONFIG_MESH_TASK_RX_NODE_PRIO,
+    },
+    [MESH_TASK_TX] = {
+        CONFIG_MESH_TASK_TX_CORE, CONFIG_MESH_TASK_TX_STACK,
+        CONFIG_MESH_TASK_TX_PRIO, CONFIG_MESH_TASK_TX_PRIO,
+    },
+    /* the uplink only polls for the root role on other nodes */
+    [MESH_TASK_UPLINK] = {
+        CONFIG_MESH_TASK_UPLINK_CORE, CONFIG_MESH_TASK_UPLINK_STACK,
+        CONFIG_MESH_TASK_UPLINK_PRIO, 1,
+    },
+};
+static TaskHandle_t s_tasks[MESH_TASK_MAX];
+static mesh_task_stats_t s_stats[MESH_TASK_MAX];
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+static bool s_is_root = false;
+static uint32_t s_role_changes = 0;
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+static BaseType_t tasks_core(int core)
+{
+#if CONFIG_FREERTOS_UNICORE
+    return 0;
+#else
+    return core < 0 ? tskNO_AFFINITY : core;
+#endif
+}
+
+esp_err_t mesh_tasks_create(mesh_task_stage_t stage, TaskFunction_t fn, const char *name,
+                            TaskHandle_t *handle)
+{
+    const task_config_t *config = &s_config[stage];
+    int prio = s_is_root ? config->root_prio : config->node_prio;
+
+    if (xTaskCreatePinnedToCore(fn, name, config->stack, NULL, prio, &s_tasks[stage],
+                                tasks_core(config->core)) != pdPASS) {
+        ESP_LOGE(TASKS_TAG, "cannot create %s", name);
+        return ESP_ERR_NO_MEM;
+    }
+    s_stats[stage].core = config->core;
+    s_stats[stage].priority = prio;
+    if (handle) {
+        *handle = s_tasks[stage];
+    }
+    ESP_LOGI(TASKS_TAG, "%s core:%d prio:%d stack:%u", name, config->core, prio, config->stack);
+    return ESP_OK;
+}
+
+/* Account one work item of a stage, from start_us until now. */
+void mesh_tasks_note_work(mesh_task_stage_t stage, int64_t start_us)
+{
+    uint32_t us = esp_timer_get_time() - start_us;
+    mesh_task_stats_t *stats = &s_stats[stage];
+
+    portENTER_CRITICAL(&s_mux);
+    stats->runs++;
+    stats->busy_us += us;
+    if (us > stats->busy_us_max) {
+        stats->busy_us_max = us;
+    }
+    portEXIT_CRITICAL(&s_mux);
+}
+
+/* Move priorities over to the root pipeline, or back, when the role changed. */
+void mesh_tasks_update_role(void)
+{
+    bool is_root = esp_mesh_is_root();
+
+    if (is_root == s_is_root) {
+        return;
+    }
+    s_is_root = is_root;
+    s_role_changes++;
+    for (int i = 0; i < MESH_TASK_MAX; i++) {
+        int prio = is_root ? s_config[i].root_prio : s_config[i].node_prio;
+        if (s_tasks[i]) {
+            vTaskPrioritySet(s_tasks[i], prio);
+        }
+        s_stats[i].priority = prio;
+    }
+    ESP_LOGI(TASKS_TAG, "role: %s", is_root ? "root" : "node");
+}
+
+uint32_t mesh_tasks_get_role_changes(void)
+{
+    return s_role_changes;
+}
+
+void mesh_tasks_get_stats(mesh_task_stage_t stage, mesh_task_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_mux);
+    *stats = s_stats[stage];
+    portEXIT_CRITICAL(&s_mux);
+    stats->stack_free = s_tasks[stage] ? uxTaskGetStackHighWaterMark(s_tasks[stage]) : 0;
+}
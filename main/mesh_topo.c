@@ -0,0 +1,409 @@
+/* Mesh Topology Map and Subtree Balancing
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <string.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_mesh.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "mesh_nodes.h"
+#include "mesh_topo.h"
+#include "sdkconfig.h"
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define TOPO_MIN_REFRESH_US     (5 * 1000000LL) /* shorter windows make noisy rates */
+#define TOPO_STALE_S            (120)
+#define TOPO_PARENT_ROOT        (-1)
+#define TOPO_PARENT_UNKNOWN     (-2)
+#define TOPO_REPARENT_HOLD_S    (300)   /* node side, ignore moves this soon after one */
+
+/*******************************************************
+ *                Structures
+ *******************************************************/
+#if CONFIG_MESH_ROOT_CAPABLE
+typedef struct {
+    int parent;             /* index, TOPO_PARENT_ROOT or TOPO_PARENT_UNKNOWN */
+    bool live;
+    uint8_t children;
+    uint32_t frames;        /* at the previous refresh */
+    uint32_t load_x100;
+    uint32_t subtree_x100;
+} topo_entry_t;
+#endif
+
+/*******************************************************
+ *                Variable Definitions
+ *******************************************************/
+static const char *TOPO_TAG = "mesh_topo";
+static SemaphoreHandle_t s_lock = NULL;
+#if CONFIG_MESH_ROOT_CAPABLE
+/* indexes follow mesh_nodes, entries there are never removed */
+static mesh_node_link_t s_links[CONFIG_MESH_ROUTE_TABLE_SIZE];
+static topo_entry_t s_topo[CONFIG_MESH_ROUTE_TABLE_SIZE];
+static mesh_addr_t s_route_table[CONFIG_MESH_ROUTE_TABLE_SIZE];
+static int s_count = 0;
+static int64_t s_refresh_us = 0;
+static volatile bool s_dirty = true;
+static uint8_t s_self_sta[6];
+static uint8_t s_self_ap[6];
+#endif
+static mesh_topo_stats_t s_stats;
+static int64_t s_reparent_us = 0;
+static volatile bool s_reparent_pending = false;
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+#if CONFIG_MESH_ROOT_CAPABLE
+static bool topo_in_route_table(const uint8_t *addr, int size)
+{
+    for (int i = 0; i < size; i++) {
+        if (!memcmp(s_route_table[i].addr, addr, 6)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static int topo_find_parent(int index)
+{
+    static const uint8_t zero[6] = { 0, };
+    const uint8_t *parent_ap = s_links[index].parent_ap;
+
+    if (!memcmp(parent_ap, zero, 6)) {
+        return TOPO_PARENT_UNKNOWN;
+    }
+    if (!memcmp(parent_ap, s_self_ap, 6)) {
+        return TOPO_PARENT_ROOT;
+    }
+    for (int i = 0; i < s_count; i++) {
+        if (i != index && s_topo[i].live && !memcmp(s_links[i].self_ap, parent_ap, 6)) {
+            return i;
+        }
+    }
+    return TOPO_PARENT_UNKNOWN;
+}
+
+/* Rebuild the map from what the nodes reported since the last call, lock held. */
+static void topo_refresh_locked(int64_t now_us)
+{
+    int64_t elapsed_us = now_us - s_refresh_us;
+    int size = 0;
+
+    if (!s_dirty && elapsed_us < TOPO_MIN_REFRESH_US) {
+        return;
+    }
+    s_dirty = false;
+    s_refresh_us = now_us;
+    s_stats.refreshes++;
+
+    esp_mesh_get_routing_table(s_route_table, CONFIG_MESH_ROUTE_TABLE_SIZE * 6, &size);
+    s_count = mesh_nodes_get_links(0, s_links, CONFIG_MESH_ROUTE_TABLE_SIZE);
+    for (int i = 0; i < s_count; i++) {
+        topo_entry_t *entry = &s_topo[i];
+        uint32_t frames = s_links[i].frames;
+        entry->load_x100 = elapsed_us > 0 ? (uint64_t)(frames - entry->frames) * 100 * 1000000 / elapsed_us : 0;
+        entry->frames = frames;
+        entry->live = s_links[i].age_s <= TOPO_STALE_S && topo_in_route_table(s_links[i].addr, size);
+        entry->children = 0;
+        entry->subtree_x100 = 0;
+    }
+
+    s_stats.nodes = 0;
+    s_stats.unresolved = 0;
+    s_stats.root_children = 0;
+    s_stats.max_children = 0;
+    s_stats.load_x100 = 0;
+    s_stats.hot_subtree_x100 = 0;
+    for (int i = 0; i < s_count; i++) {
+        topo_entry_t *entry = &s_topo[i];
+        entry->parent = entry->live ? topo_find_parent(i) : TOPO_PARENT_UNKNOWN;
+        if (!entry->live) {
+            continue;
+        }
+        s_stats.nodes++;
+        s_stats.load_x100 += entry->load_x100;
+        if (entry->parent == TOPO_PARENT_ROOT) {
+            s_stats.root_children++;
+        } else if (entry->parent == TOPO_PARENT_UNKNOWN) {
+            s_stats.unresolved++;
+        } else {
+            s_topo[entry->parent].children++;
+        }
+        /* bounded, a stale report can make a loop until the next refresh */
+        int p = i;
+        for (int depth = 0; p >= 0 && depth < CONFIG_MESH_MAX_LAYER; depth++) {
+            s_topo[p].subtree_x100 += entry->load_x100;
+            p = s_topo[p].parent;
+        }
+    }
+    for (int i = 0; i < s_count; i++) {
+        if (!s_topo[i].live) {
+            continue;
+        }
+        if (s_topo[i].children > s_stats.max_children) {
+            s_stats.max_children = s_topo[i].children;
+        }
+        if (s_topo[i].parent == TOPO_PARENT_ROOT && s_topo[i].subtree_x100 > s_stats.hot_subtree_x100) {
+            s_stats.hot_subtree_x100 = s_topo[i].subtree_x100;
+        }
+    }
+}
+
+void mesh_topo_refresh(void)
+{
+    if (!esp_mesh_is_root()) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    topo_refresh_locked(esp_timer_get_time());
+    xSemaphoreGive(s_lock);
+}
+
+void mesh_topo_invalidate(void)
+{
+    s_dirty = true;
+}
+
+esp_err_t mesh_topo_get_node(const uint8_t *addr, mesh_topo_node_t *node)
+{
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (int i = 0; i < s_count; i++) {
+        const topo_entry_t *entry = &s_topo[i];
+        if (memcmp(s_links[i].addr, addr, 6)) {
+            continue;
+        }
+        memcpy(node->addr, addr, sizeof(node->addr));
+        node->parent_known = entry->parent != TOPO_PARENT_UNKNOWN;
+        if (entry->parent >= 0) {
+            memcpy(node->parent, s_links[entry->parent].addr, sizeof(node->parent));
+        } else {
+            memcpy(node->parent, s_self_sta, sizeof(node->parent));
+        }
+        node->layer = s_links[i].layer;
+        node->children = entry->children;
+        node->load_x100 = entry->load_x100;
+        node->subtree_x100 = entry->subtree_x100;
+        err = ESP_OK;
+        break;
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
+#endif
+
+/* Node side: reconnect to the parent the root picked, same SSID and channel. */
+void mesh_topo_recv_reparent(const mesh_addr_t *from, const uint8_t *frame, int size)
+{
+    mesh_topo_reparent_t req;
+    mesh_addr_t parent = { 0, };
+    mesh_addr_t mesh_id;
+    wifi_config_t cfg;
+    int64_t now_us = esp_timer_get_time();
+
+    if (size < sizeof(req) || esp_mesh_is_root()) {
+        return;
+    }
+    memcpy(&req, frame, sizeof(req));
+    esp_mesh_get_parent_bssid(&parent);
+    if (!memcmp(parent.addr, req.bssid, 6)) {
+        return;
+    }
+    if (s_reparent_us && now_us - s_reparent_us < TOPO_REPARENT_HOLD_S * 1000000LL) {
+        ESP_LOGW(TOPO_TAG, "ignore move to "MACSTR", moved %ds ago", MAC2STR(req.bssid),
+                 (int)((now_us - s_reparent_us) / 1000000));
+        return;
+    }
+    s_reparent_us = now_us;
+
+    esp_err_t err = esp_wifi_get_config(ESP_IF_WIFI_STA, &cfg);
+    if (err == ESP_OK) {
+        err = esp_mesh_get_id(&mesh_id);
+    }
+    if (err == ESP_OK) {
+        memcpy(cfg.sta.bssid, req.bssid, sizeof(cfg.sta.bssid));
+        cfg.sta.bssid_set = 1;
+        /* leaves self-organizing off until the new parent is connected */
+        err = esp_mesh_set_parent(&cfg, &mesh_id, MESH_NODE, req.layer);
+    }
+    if (err != ESP_OK) {
+        s_stats.reparent_errors++;
+        ESP_LOGE(TOPO_TAG, "move to "MACSTR" failed: 0x%x", MAC2STR(req.bssid), err);
+        return;
+    }
+    s_reparent_pending = true;
+    s_stats.reparents++;
+    ESP_LOGW(TOPO_TAG, "moving from "MACSTR" to "MACSTR", asked by "MACSTR"",
+             MAC2STR(parent.addr), MAC2STR(req.bssid), MAC2STR(from->addr));
+}
+
+/* Hand parent selection back to the mesh once a move connected or failed. */
+void mesh_topo_reparent_done(void)
+{
+    if (s_reparent_pending) {
+        s_reparent_pending = false;
+        esp_mesh_set_self_organized(true, false);
+    }
+}
+
+#if CONFIG_MESH_BALANCE
+/* Pick one child of the busiest parent to move under the least loaded parent of
+ * the same layer, so the node keeps its path length. Lock held. */
+static bool topo_pick_move(int *child, int *target)
+{
+    int hot = -1;
+
+    for (int layer = 2; layer <= CONFIG_MESH_MAX_LAYER; layer++) {
+        uint32_t sum = 0;
+        int parents = 0;
+        for (int i = 0; i < s_count; i++) {
+            if (s_topo[i].live && s_links[i].layer == layer) {
+                sum += s_topo[i].subtree_x100;
+                parents++;
+            }
+        }
+        if (parents < 2) {
+            continue;
+        }
+        for (int i = 0; i < s_count; i++) {
+            const topo_entry_t *entry = &s_topo[i];
+            if (!entry->live || s_links[i].layer != layer || !entry->children) {
+                continue;
+            }
+            bool full = entry->children >= CONFIG_MESH_AP_CONNECTIONS;
+            bool busy = (uint64_t)entry->subtree_x100 * parents * 100 > (uint64_t)sum * CONFIG_MESH_BALANCE_FACTOR_PCT;
+            if ((full || busy) && (hot < 0 || entry->subtree_x100 > s_topo[hot].subtree_x100)) {
+                hot = i;
+            }
+        }
+    }
+    if (hot < 0) {
+        return false;
+    }
+
+    int cold = -1;
+    for (int i = 0; i < s_count; i++) {
+        if (i != hot && s_topo[i].live && s_links[i].layer == s_links[hot].layer
+                && s_topo[i].children < CONFIG_MESH_AP_CONNECTIONS
+                && (cold < 0 || s_topo[i].subtree_x100 < s_topo[cold].subtree_x100)) {
+            cold = i;
+        }
+    }
+    if (cold < 0 || s_topo[cold].subtree_x100 > s_topo[hot].subtree_x100) {
+        return false;
+    }
+
+    /* the move only helps if the child carries less than the gap */
+    uint32_t gap = s_topo[hot].subtree_x100 - s_topo[cold].subtree_x100;
+    bool full = s_topo[hot].children >= CONFIG_MESH_AP_CONNECTIONS;
+    int best = -1;
+    uint32_t best_diff = UINT32_MAX;
+    for (int i = 0; i < s_count; i++) {
+        uint32_t load = s_topo[i].subtree_x100;
+        if (!s_topo[i].live || s_topo[i].parent != hot || load > gap || (load == gap && !full)) {
+            continue;
+        }
+        uint32_t diff = load > gap / 2 ? load - gap / 2 : gap / 2 - load;
+        if (diff < best_diff) {
+            best_diff = diff;
+            best = i;
+        }
+    }
+    if (best < 0) {
+        return false;
+    }
+    *child = best;
+    *target = cold;
+    return true;
+}
+
+static void topo_balance(void)
+{
+    mesh_topo_reparent_t req = { .type = MESH_FRAME_REPARENT, };
+    mesh_addr_t child;
+    int c, t;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    topo_refresh_locked(esp_timer_get_time());
+    bool move = topo_pick_move(&c, &t);
+    if (move) {
+        memcpy(child.addr, s_links[c].addr, 6);
+        memcpy(req.bssid, s_links[t].self_ap, sizeof(req.bssid));
+        req.layer = s_links[c].layer;
+        ESP_LOGW(TOPO_TAG, "move "MACSTR" (%u.%02u/s) from "MACSTR" (%u.%02u/s) to "MACSTR" (%u.%02u/s)",
+                 MAC2STR(child.addr), s_topo[c].subtree_x100 / 100, s_topo[c].subtree_x100 % 100,
+                 MAC2STR(s_links[s_topo[c].parent].addr),
+                 s_topo[s_topo[c].parent].subtree_x100 / 100, s_topo[s_topo[c].parent].subtree_x100 % 100,
+                 MAC2STR(s_links[t].addr), s_topo[t].subtree_x100 / 100, s_topo[t].subtree_x100 % 100);
+    }
+    xSemaphoreGive(s_lock);
+    if (!move) {
+        return;
+    }
+
+    mesh_data_t data = {
+        .data = (uint8_t *)&req,
+        .size = sizeof(req),
+        .proto = MESH_PROTO_BIN,
+        .tos = MESH_TOS_P2P,
+    };
+    esp_err_t err = esp_mesh_send(&child, &data, MESH_DATA_P2P, NULL, 0);
+    if (err != ESP_OK) {
+        ESP_LOGE(TOPO_TAG, "move request to "MACSTR" failed: 0x%x", MAC2STR(child.addr), err);
+        return;
+    }
+    s_stats.moves_sent++;
+    /* the old and new parent both change, look again next interval */
+    s_dirty = true;
+}
+
+static void mesh_topo_task(void *arg)
+{
+    while (true) {
+        vTaskDelay(CONFIG_MESH_BALANCE_INTERVAL_S * 1000 / portTICK_PERIOD_MS);
+        if (esp_mesh_is_root()) {
+            topo_balance();
+        }
+    }
+}
+#endif
+
+void mesh_topo_get_stats(mesh_topo_stats_t *stats)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *stats = s_stats;
+    xSemaphoreGive(s_lock);
+}
+
+esp_err_t mesh_topo_init(void)
+{
+    s_lock = xSemaphoreCreateMutex();
+    if (!s_lock) {
+        return ESP_ERR_NO_MEM;
+    }
+#if CONFIG_MESH_ROOT_CAPABLE
+    esp_read_mac(s_self_sta, ESP_MAC_WIFI_STA);
+    esp_read_mac(s_self_ap, ESP_MAC_WIFI_SOFTAP);
+#endif
+#if CONFIG_MESH_BALANCE
+    if (xTaskCreate(mesh_topo_task, "MTOP", 3072, NULL, 2, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+#endif
+    return ESP_OK;
+}
@@ -0,0 +1,191 @@
+/* Mesh Non-blocking Send Path
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <string.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_mesh.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "mesh_tx.h"
+#include "sdkconfig.h"
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define TX_QUEUE_SIZE           (CONFIG_MESH_TX_QUEUE_SIZE)
+#define TX_PENDING_MAX          (CONFIG_MESH_TX_PENDING_MAX)
+#define TX_RETRY_MAX            (CONFIG_MESH_TX_RETRY_MAX)
+#define TX_BACKOFF_MIN_MS       (50)
+#define TX_BACKOFF_MAX_MS       (5000)
+
+/*******************************************************
+ *                Structures
+ *******************************************************/
+typedef struct {
+    uint8_t frame[MESH_TX_FRAME_MAX];
+    uint8_t len;
+    uint8_t attempts;
+} tx_entry_t;
+
+/*******************************************************
+ *                Variable Definitions
+ *******************************************************/
+static const char *TX_TAG = "mesh_tx";
+/* only the tx task sends, the queue needs no lock */
+static tx_entry_t s_queue[TX_QUEUE_SIZE];
+static int s_head = 0;
+static int s_count = 0;
+static int64_t s_next_try_us = 0;
+static uint32_t s_backoff_ms = TX_BACKOFF_MIN_MS;
+static mesh_tx_stats_t s_stats;
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+static bool tx_backed_up(void)
+{
+    mesh_tx_pending_t pending;
+
+    if (esp_mesh_get_tx_pending(&pending) != ESP_OK) {
+        return false;
+    }
+    return pending.to_parent >= TX_PENDING_MAX;
+}
+
+static esp_err_t tx_try(const uint8_t *frame, size_t len)
+{
+    mesh_data_t data = {
+        .data = (uint8_t *)frame,
+        .size = len,
+        .proto = MESH_PROTO_BIN,
+        .tos = MESH_TOS_P2P,
+    };
+
+    esp_err_t err = esp_mesh_send(NULL, &data, MESH_DATA_NONBLOCK, NULL, 0);
+    if (err != ESP_OK) {
+        s_stats.failed++;
+    }
+    return err;
+}
+
+static void tx_backoff(void)
+{
+    /* jitter keeps siblings of a congested parent from retrying together */
+    s_next_try_us = esp_timer_get_time() + (s_backoff_ms + esp_random() % s_backoff_ms) * 1000LL;
+    s_backoff_ms = s_backoff_ms * 2 > TX_BACKOFF_MAX_MS ? TX_BACKOFF_MAX_MS : s_backoff_ms * 2;
+}
+
+static void tx_pop(void)
+{
+    s_head = (s_head + 1) % TX_QUEUE_SIZE;
+    s_count--;
+    s_stats.queued = s_count;
+}
+
+static void tx_enqueue(const uint8_t *frame, size_t len, uint8_t attempts)
+{
+    if (s_count == TX_QUEUE_SIZE) {
+        /* the newest reading is worth more than the oldest */
+        tx_pop();
+        s_stats.dropped++;
+    }
+    tx_entry_t *entry = &s_queue[(s_head + s_count) % TX_QUEUE_SIZE];
+    memcpy(entry->frame, frame, len);
+    entry->len = len;
+    entry->attempts = attempts;
+    s_count++;
+    s_stats.deferred++;
+    s_stats.queued = s_count;
+    if (s_count > s_stats.queued_max) {
+        s_stats.queued_max = s_count;
+    }
+}
+
+/* Send queued frames oldest first until the parent pushes back. */
+static void tx_service(void)
+{
+    while (s_count && esp_timer_get_time() >= s_next_try_us) {
+        tx_entry_t *entry = &s_queue[s_head];
+        if (tx_backed_up()) {
+            tx_backoff();
+            return;
+        }
+        esp_err_t err = tx_try(entry->frame, entry->len);
+        if (err != ESP_OK) {
+            if (++entry->attempts >= TX_RETRY_MAX) {
+                ESP_LOGW(TX_TAG, "drop frame after %d attempts, err:0x%x", entry->attempts, err);
+                tx_pop();
+                s_stats.dropped++;
+            }
+            tx_backoff();
+            return;
+        }
+        /* a frame deferred by back-pressure goes out on its first attempt */
+        if (entry->attempts > 0) {
+            s_stats.retried++;
+        }
+        tx_pop();
+        s_stats.sent++;
+        s_backoff_ms = TX_BACKOFF_MIN_MS;
+    }
+}
+
+/* Send a frame towards the root without blocking. The frame is queued for
+ * a later retry when the parent is backed up or the send fails; that
+ * returns the reason, ESP_ERR_MESH_QUEUE_FULL for back-pressure. */
+esp_err_t mesh_tx_send(const uint8_t *frame, size_t len)
+{
+    if (len > MESH_TX_FRAME_MAX) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    tx_service();
+    /* stay behind what is already waiting, readings keep their order */
+    if (s_count) {
+        tx_enqueue(frame, len, 0);
+        return ESP_ERR_MESH_QUEUE_FULL;
+    }
+    if (tx_backed_up()) {
+        tx_enqueue(frame, len, 0);
+        tx_backoff();
+        return ESP_ERR_MESH_QUEUE_FULL;
+    }
+    esp_err_t err = tx_try(frame, len);
+    if (err != ESP_OK) {
+        tx_enqueue(frame, len, 1);
+        tx_backoff();
+        return err;
+    }
+    s_stats.sent++;
+    s_backoff_ms = TX_BACKOFF_MIN_MS;
+    return ESP_OK;
+}
+
+/* Sleep for ms, waking up to retry queued frames when their backoff ends. */
+void mesh_tx_wait(uint32_t ms)
+{
+    int64_t until = esp_timer_get_time() + ms * 1000LL;
+
+    while (true) {
+        tx_service();
+        int64_t now = esp_timer_get_time();
+        if (now >= until) {
+            return;
+        }
+        int64_t wake = s_count && s_next_try_us < until ? s_next_try_us : until;
+        vTaskDelay((wake - now) / 1000 / portTICK_PERIOD_MS + 1);
+    }
+}
+
+void mesh_tx_get_stats(mesh_tx_stats_t *stats)
+{
+    *stats = s_stats;
+}
@@ -0,0 +1,343 @@
+/* Mesh HTTP Uplink
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <string.h>
+#include <strings.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_http_client.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "lwip/dns.h"
+#include "lwip/tcpip.h"
+#include "mesh_uplink.h"
+#include "sdkconfig.h"
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define UPLINK_DEADLINE_US      (CONFIG_MESH_UPLINK_TIMEOUT_MS * 1000LL)
+/* connect and request, body, answer headers, rest of the answer: each gets a
+ * share of the deadline as the client's timeout_ms, which bounds one call */
+#define UPLINK_STEPS            (4)
+#define UPLINK_STEP_MS          (CONFIG_MESH_UPLINK_TIMEOUT_MS / UPLINK_STEPS)
+#define UPLINK_STEP_US          (UPLINK_STEP_MS * 1000LL)
+#define UPLINK_READ_CHUNK       (64)
+#define UPLINK_OPEN_MS          (CONFIG_MESH_UPLINK_BREAKER_OPEN_MS)
+#define UPLINK_OPEN_MAX_MS      (UPLINK_OPEN_MS * 8)
+#define UPLINK_EWMA_SHIFT       (3)
+
+/*******************************************************
+ *                Variable Definitions
+ *******************************************************/
+static const char *UPLINK_TAG = "mesh_uplink";
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+/* kept between posts so a healthy collector is not reconnected every time */
+static esp_http_client_handle_t s_client = NULL;
+static bool s_peer_closes = false;          /* the last answer asked to close the connection */
+static volatile bool s_reconnect = false;   /* the station got a new address since the last post */
+static char s_host[64];
+static int s_failures = 0;                  /* in a row */
+static int64_t s_open_until_us = 0;
+static mesh_uplink_stats_t s_stats = {
+    .state = MESH_UPLINK_CLOSED,
+    .open_ms = UPLINK_OPEN_MS,
+};
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+static esp_err_t uplink_event_handler(esp_http_client_event_t *evt)
+{
+    switch (evt->event_id) {
+    case HTTP_EVENT_ERROR:
+        ESP_LOGD(UPLINK_TAG, "HTTP_EVENT_ERROR");
+        break;
+    case HTTP_EVENT_ON_HEADER:
+        if (!strcasecmp(evt->header_key, "Connection") && !strcasecmp(evt->header_value, "close")) {
+            s_peer_closes = true;
+        }
+        break;
+    case HTTP_EVENT_ON_DATA:
+        ESP_LOGD(UPLINK_TAG, "HTTP_EVENT_ON_DATA, len=%d", evt->data_len);
+        break;
+    default:
+        break;
+    }
+    return ESP_OK;
+}
+
+/* Called with s_mux held. */
+static void uplink_open(int64_t now_us)
+{
+    s_stats.state = MESH_UPLINK_OPEN;
+    s_stats.opened++;
+    s_open_until_us = now_us + s_stats.open_ms * 1000LL;
+}
+
+/* False when the post should fail fast. Past the open period the caller's
+ * post becomes the probe, others fail fast until it is done. */
+static bool uplink_allow(int64_t now_us)
+{
+    bool allow = true;
+
+    portENTER_CRITICAL(&s_mux);
+    if (s_stats.state == MESH_UPLINK_HALF_OPEN) {
+        s_stats.rejected++;
+        allow = false;
+    } else if (s_stats.state == MESH_UPLINK_OPEN) {
+        if (now_us < s_open_until_us) {
+            s_stats.rejected++;
+            allow = false;
+        } else {
+            s_stats.state = MESH_UPLINK_HALF_OPEN;
+            s_stats.probes++;
+        }
+    }
+    if (allow) {
+        s_stats.requests++;
+    }
+    portEXIT_CRITICAL(&s_mux);
+    return allow;
+}
+
+/* The post was allowed but never sent, a probe goes back to open. */
+static void uplink_release(void)
+{
+    portENTER_CRITICAL(&s_mux);
+    s_stats.requests--;
+    if (s_stats.state == MESH_UPLINK_HALF_OPEN) {
+        s_stats.probes--;
+        s_stats.state = MESH_UPLINK_OPEN;
+    }
+    portEXIT_CRITICAL(&s_mux);
+}
+
+static void uplink_done(esp_err_t result, uint32_t elapsed_us)
+{
+    int64_t now_us = esp_timer_get_time();
+    uint32_t prev, state, open_ms;
+
+    portENTER_CRITICAL(&s_mux);
+    prev = s_stats.state;
+    s_stats.last_us = elapsed_us;
+    if (!s_stats.avg_us) {
+        s_stats.avg_us = elapsed_us;
+    } else {
+        s_stats.avg_us += ((int32_t)elapsed_us - (int32_t)s_stats.avg_us) >> UPLINK_EWMA_SHIFT;
+    }
+    if (elapsed_us > s_stats.max_us) {
+        s_stats.max_us = elapsed_us;
+    }
+    if (result == ESP_OK) {
+        s_stats.ok++;
+        s_stats.state = MESH_UPLINK_CLOSED;
+        s_stats.open_ms = UPLINK_OPEN_MS;
+        s_failures = 0;
+    } else {
+        if (result == ESP_ERR_TIMEOUT) {
+            s_stats.slow++;
+        } else {
+            s_stats.failed++;
+        }
+        if (s_stats.state == MESH_UPLINK_HALF_OPEN) {
+            /* the collector is still down, wait longer before the next probe */
+            s_stats.open_ms = s_stats.open_ms * 2 > UPLINK_OPEN_MAX_MS ? UPLINK_OPEN_MAX_MS : s_stats.open_ms * 2;
+            uplink_open(now_us);
+        } else if (++s_failures >= CONFIG_MESH_UPLINK_BREAKER_FAILURES) {
+            uplink_open(now_us);
+        }
+    }
+    state = s_stats.state;
+    open_ms = s_stats.open_ms;
+    portEXIT_CRITICAL(&s_mux);
+
+    if (state != prev) {
+        if (state == MESH_UPLINK_OPEN) {
+            ESP_LOGW(UPLINK_TAG, "collector failing, posts fail fast for %ums", open_ms);
+        } else if (state == MESH_UPLINK_CLOSED) {
+            ESP_LOGI(UPLINK_TAG, "collector recovered, %uus", elapsed_us);
+        }
+    }
+}
+
+/* ESP_OK when a whole step still fits before the deadline. */
+static esp_err_t uplink_step(int64_t deadline_us, int64_t *step_start_us)
+{
+    *step_start_us = esp_timer_get_time();
+    return deadline_us - *step_start_us >= UPLINK_STEP_US ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+/* A step that waited out its timeout ran into the deadline, anything else is an error. */
+static esp_err_t uplink_step_failed(int64_t step_start_us)
+{
+    return esp_timer_get_time() - step_start_us >= UPLINK_STEP_US ? ESP_ERR_TIMEOUT : ESP_FAIL;
+}
+
+/* One request and answer on s_client. Every blocking call waits at most
+ * UPLINK_STEP_MS and only starts while that still fits before deadline_us. */
+static esp_err_t uplink_exchange(const char *body, int len, int64_t deadline_us, int *status)
+{
+    char answer[UPLINK_READ_CHUNK];
+    int64_t step_us;
+    int n;
+
+    /* connects first on a new connection, DNS and the TCP handshake are bounded by lwIP */
+    if (uplink_step(deadline_us, &step_us) != ESP_OK) {
+        return ESP_ERR_TIMEOUT;
+    }
+    if (esp_http_client_open(s_client, len) != ESP_OK) {
+        return uplink_step_failed(step_us);
+    }
+    for (int sent = 0; sent < len; sent += n) {
+        if (uplink_step(deadline_us, &step_us) != ESP_OK) {
+            return ESP_ERR_TIMEOUT;
+        }
+        n = esp_http_client_write(s_client, body + sent, len - sent);
+        if (n <= 0) {
+            return uplink_step_failed(step_us);
+        }
+    }
+    if (uplink_step(deadline_us, &step_us) != ESP_OK) {
+        return ESP_ERR_TIMEOUT;
+    }
+    int length = esp_http_client_fetch_headers(s_client);
+    if (length < 0) {
+        return uplink_step_failed(step_us);
+    }
+    *status = esp_http_client_get_status_code(s_client);
+    /* drain the answer, the connection carries the next post */
+    for (int got = 0; length <= 0 || got < length; got += n) {
+        if (uplink_step(deadline_us, &step_us) != ESP_OK) {
+            return ESP_ERR_TIMEOUT;
+        }
+        n = esp_http_client_read(s_client, answer, sizeof(answer));
+        if (n < 0) {
+            return uplink_step_failed(step_us);
+        }
+        if (n == 0) {
+            break;
+        }
+    }
+    return ESP_OK;
+}
+
+/* Post one reading or summary as data=<json>. Returns ESP_ERR_INVALID_STATE
+ * without touching the network while the breaker is open, ESP_ERR_TIMEOUT
+ * when the collector did not answer within the deadline. */
+esp_err_t mesh_uplink_post(const char *data)
+{
+    int64_t start_us = esp_timer_get_time();
+    char *post_data;
+    int status = 0;
+
+    if (!uplink_allow(start_us)) {
+        uint32_t us = esp_timer_get_time() - start_us;
+        portENTER_CRITICAL(&s_mux);
+        if (us > s_stats.reject_us_max) {
+            s_stats.reject_us_max = us;
+        }
+        portEXIT_CRITICAL(&s_mux);
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (s_reconnect) {
+        s_reconnect = false;
+        if (s_client) {
+            /* kept from an earlier stint as root, the socket died with the old address */
+            esp_http_client_cleanup(s_client);
+            s_client = NULL;
+        }
+    }
+    if (!s_client) {
+        esp_http_client_config_t config = {
+            .url = CONFIG_MESH_UPLINK_URL,
+            .method = HTTP_METHOD_POST,
+            .timeout_ms = UPLINK_STEP_MS,
+            .event_handler = uplink_event_handler,
+        };
+        s_client = esp_http_client_init(&config);
+    }
+    int len = asprintf(&post_data, "data=%s", data);
+    if (!s_client || len < 0) {
+        /* not the collector's fault, leave the breaker alone */
+        uplink_release();
+        return ESP_ERR_NO_MEM;
+    }
+
+    s_peer_closes = false;
+    esp_err_t result = uplink_exchange(post_data, len, start_us + UPLINK_DEADLINE_US, &status);
+    uint32_t elapsed_us = esp_timer_get_time() - start_us;
+    free(post_data);
+
+    if (result == ESP_ERR_TIMEOUT) {
+        /* a collector that answers this late is failing too */
+        ESP_LOGW(UPLINK_TAG, "POST cut off after %uus, status %d, %ums deadline",
+                 elapsed_us, status, CONFIG_MESH_UPLINK_TIMEOUT_MS);
+    } else if (result != ESP_OK || status >= 500) {
+        ESP_LOGE(UPLINK_TAG, "POST failed: %s, status %d, %uus",
+                 esp_err_to_name(result), status, elapsed_us);
+        result = result != ESP_OK ? result : ESP_FAIL;
+    } else {
+        ESP_LOGD(UPLINK_TAG, "POST status %d, %uus", status, elapsed_us);
+    }
+    if (result != ESP_OK || s_peer_closes) {
+        /* never reuse a connection that may be stuck mid-response or is being closed */
+        esp_http_client_cleanup(s_client);
+        s_client = NULL;
+    }
+    uplink_done(result, elapsed_us);
+    return result;
+}
+
+static void uplink_resolved(const char *name, const ip_addr_t *addr, void *arg)
+{
+    ESP_LOGI(UPLINK_TAG, "collector %s %s", name, addr ? "resolved" : "not resolved");
+}
+
+/* Runs in the lwIP thread, dns_gethostbyname() only starts the lookup. */
+static void uplink_resolve(void *arg)
+{
+    ip_addr_t addr;
+
+    if (dns_gethostbyname(s_host, &addr, uplink_resolved, NULL) == ERR_OK) {
+        ESP_LOGD(UPLINK_TAG, "collector %s cached or an address", s_host);
+    }
+}
+
+/* Called once the station has an address. This client cannot connect without sending a
+ * request, so the first post still opens the connection. A connection kept from an earlier
+ * stint as root is dropped then, and the collector's name is resolved now. */
+void mesh_uplink_prewarm(void)
+{
+    const char *host = strstr(CONFIG_MESH_UPLINK_URL, "://");
+
+    s_reconnect = true;
+    host = host ? host + 3 : CONFIG_MESH_UPLINK_URL;
+    size_t len = strcspn(host, ":/?");
+    if (!len || len >= sizeof(s_host)) {
+        return;
+    }
+    memcpy(s_host, host, len);
+    s_host[len] = '\0';
+    tcpip_callback(uplink_resolve, NULL);
+}
+
+void mesh_uplink_get_stats(mesh_uplink_stats_t *stats)
+{
+    int64_t now_us = esp_timer_get_time();
+
+    portENTER_CRITICAL(&s_mux);
+    *stats = s_stats;
+    stats->retry_in_ms = s_stats.state == MESH_UPLINK_OPEN && s_open_until_us > now_us
+                         ? (s_open_until_us - now_us) / 1000 : 0;
+    portEXIT_CRITICAL(&s_mux);
+}
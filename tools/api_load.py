@@ -0,0 +1,82 @@
+#!/usr/bin/env python3
+#
+# Load generator for the root's local read API (CONFIG_MESH_LOCAL_API).
+#
+# Runs a number of keep-alive clients against /nodes, /topology and /stats
+# and reports requests per second and latency percentiles.
+#
+# This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+import argparse
+import http.client
+import threading
+import time
+
+
+def client(args, paths, results, stop):
+    conn = None
+    latencies = []
+    errors = 0
+    i = 0
+    while not stop.is_set():
+        path = paths[i % len(paths)]
+        i += 1
+        try:
+            if conn is None:
+                conn = http.client.HTTPConnection(args.host, args.port, timeout=args.timeout)
+            start = time.monotonic()
+            conn.request('GET', path)
+            resp = conn.getresponse()
+            resp.read()
+            if resp.status != 200:
+                errors += 1
+            latencies.append(time.monotonic() - start)
+        except (OSError, http.client.HTTPException):
+            errors += 1
+            if conn is not None:
+                conn.close()
+            conn = None
+    if conn is not None:
+        conn.close()
+    results.append((latencies, errors))
+
+
+def percentile(values, p):
+    if not values:
+        return 0.0
+    return values[min(len(values) - 1, int(len(values) * p / 100.0))]
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Mesh root local API load generator')
+    parser.add_argument('host')
+    parser.add_argument('--port', type=int, default=80)
+    parser.add_argument('--clients', type=int, default=4)
+    parser.add_argument('--duration', type=float, default=30.0, help='seconds')
+    parser.add_argument('--timeout', type=float, default=5.0)
+    parser.add_argument('--path', action='append', help='endpoint to request, repeatable')
+    args = parser.parse_args()
+    paths = args.path or ['/nodes', '/topology', '/stats']
+
+    results = []
+    stop = threading.Event()
+    threads = [threading.Thread(target=client, args=(args, paths, results, stop))
+               for _ in range(args.clients)]
+    for t in threads:
+        t.start()
+    time.sleep(args.duration)
+    stop.set()
+    for t in threads:
+        t.join()
+
+    latencies = sorted(l for r in results for l in r[0])
+    errors = sum(r[1] for r in results)
+    print('clients:%d requests:%d errors:%d req/s:%.1f' % (args.clients, len(latencies), errors,
+                                                             len(latencies) / args.duration))
+    print('latency ms p50:%.1f p90:%.1f p99:%.1f max:%.1f'
+          % (percentile(latencies, 50) * 1000, percentile(latencies, 90) * 1000,
+             percentile(latencies, 99) * 1000, (latencies[-1] if latencies else 0) * 1000))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,281 @@
+#!/usr/bin/env python3
+#
+# Record and replay root ingress captures (CONFIG_MESH_CAPTURE).
+#
+#   record  listen for the root's capture connection and write a .mcap file
+#   info    print the traffic shape of a capture
+#   replay  feed a capture into a host model of the root ingest path at the
+#           original pace, faster (--speed 10) or as fast as possible (--speed 0)
+#
+# The host model mirrors esp_mesh_p2p_rx_projeto and mesh_nodes_check_seq:
+# frame type dispatch, the 64 sequence dedup window per sender and boot
+# session (main/mesh_seq.c) and the EWMA update. Layouts match
+# main/include/mesh_capture.h and main/mesh_main.c.
+#
+# This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+import argparse
+import asyncio
+import struct
+import sys
+import time
+
+MAGIC = 0x5041434d
+VERSION = 1
+
+HDR = struct.Struct('<IB6sHI')
+REC = struct.Struct('<IH6sHHHH')
+
+FRAME_READING = 0x00
+FRAME_NAMES = {0x00: 'reading', 0x10: 'handoff_nodes', 0x11: 'handoff_records',
+               0x12: 'handoff_done', 0x20: 'reparent'}
+FRAME_NODE_ID = 22
+FRAME_TEMPERATURE = 23
+FRAME_HUMIDITY = 24
+FRAME_LAYER = 25
+FRAME_SEQ = 26
+FRAME_SESSION = 30
+FRAME_SIZE = 32
+
+SEQ_WINDOW = 64
+SEQ_MASK = (1 << SEQ_WINDOW) - 1
+EWMA_ONE = 256
+EWMA_SHIFT = 3
+
+
+def mac_str(mac):
+    return ':'.join('%02x' % b for b in mac)
+
+
+def read_capture(path):
+    """Yield (time_us, from, flag, size, dropped, frame) for every record."""
+    with open(path, 'rb') as f:
+        data = f.read()
+    if len(data) < HDR.size:
+        raise ValueError('%s: too short' % path)
+    magic, version, root, snaplen, session = HDR.unpack_from(data)
+    if magic != MAGIC or version != VERSION:
+        raise ValueError('%s: not a capture (magic:0x%x version:%d)' % (path, magic, version))
+    off = HDR.size
+    while off + REC.size <= len(data):
+        time_ms, time_us, addr, flag, size, caplen, dropped = REC.unpack_from(data, off)
+        off += REC.size
+        if off + caplen > len(data):
+            break
+        yield time_ms * 1000 + time_us, addr, flag, size, dropped, data[off:off + caplen]
+        off += caplen
+
+
+class Node(object):
+
+    def __init__(self):
+        self.high_seq = 0
+        self.window = 0
+        self.session = 0
+        self.ewma = {}
+
+
+class Ingest(object):
+    """Host model of the root receive path, one call per captured frame."""
+
+    def __init__(self):
+        self.nodes = {}
+        self.counts = dict.fromkeys(('frames', 'readings', 'control', 'short', 'received',
+                                     'duplicates', 'reordered', 'lost', 'late', 'restarts'), 0)
+
+    def check_seq(self, node, session, seq):
+        c = self.counts
+        if not node.window or session != node.session:
+            if node.window:
+                c['restarts'] += 1
+            node.session, node.high_seq, node.window = session, seq, SEQ_MASK
+            return True
+        if seq > node.high_seq:
+            shift = seq - node.high_seq
+            if shift >= SEQ_WINDOW:
+                c['lost'] += SEQ_WINDOW - bin(node.window).count('1') + shift - SEQ_WINDOW
+                node.window = 0
+            else:
+                c['lost'] += shift - bin(node.window >> (SEQ_WINDOW - shift)).count('1')
+                node.window = (node.window << shift) & SEQ_MASK
+            node.window |= 1
+            node.high_seq = seq
+            return True
+        if node.high_seq - seq >= SEQ_WINDOW:
+            c['late'] += 1
+            return False
+        bit = 1 << (node.high_seq - seq)
+        if node.window & bit:
+            c['duplicates'] += 1
+            return False
+        node.window |= bit
+        c['reordered'] += 1
+        return True
+
+    def update(self, node, name, value):
+        if name not in node.ewma:
+            node.ewma[name] = value * EWMA_ONE
+        else:
+            node.ewma[name] += (value * EWMA_ONE - node.ewma[name]) >> EWMA_SHIFT
+
+    def frame(self, addr, frame):
+        c = self.counts
+        c['frames'] += 1
+        if frame[0] != FRAME_READING:
+            c['control'] += 1
+            return
+        if len(frame) < FRAME_SIZE:
+            c['short'] += 1
+            return
+        c['readings'] += 1
+        node = self.nodes.get(addr)
+        if node is None:
+            node = self.nodes[addr] = Node()
+        seq = struct.unpack_from('<I', frame, FRAME_SEQ)[0]
+        session = struct.unpack_from('<H', frame, FRAME_SESSION)[0]
+        if not self.check_seq(node, session, seq):
+            return
+        c['received'] += 1
+        self.update(node, 'temperature', struct.unpack_from('<b', frame, FRAME_TEMPERATURE)[0])
+        self.update(node, 'humidity', frame[FRAME_HUMIDITY])
+
+
+class Recorder(object):
+
+    def __init__(self, args):
+        self.args = args
+        self.out = open(args.output, 'wb')
+        self.header_written = False
+
+    async def handle(self, reader, writer):
+        peer = writer.get_extra_info('peername')
+        records = dropped = 0
+        try:
+            hdr = await reader.readexactly(HDR.size)
+            magic, version, root, snaplen, session = HDR.unpack(hdr)
+            if magic != MAGIC or version != VERSION:
+                print('%s: bad header magic:0x%x version:%d' % (peer, magic, version))
+                return
+            print('%s: root %s session %08x snaplen %d' % (peer, mac_str(root), session, snaplen))
+            # later connections (root switch, reconnect) append to the same file
+            if not self.header_written:
+                self.out.write(hdr)
+                self.header_written = True
+            while True:
+                rec = await reader.readexactly(REC.size)
+                caplen, rec_dropped = REC.unpack(rec)[5:7]
+                frame = await reader.readexactly(caplen)
+                self.out.write(rec + frame)
+                records += 1
+                dropped += rec_dropped
+        except (asyncio.IncompleteReadError, ConnectionError):
+            pass
+        finally:
+            self.out.flush()
+            print('%s: disconnected, %d records, %d dropped on the root'
+                  % (peer, records, dropped))
+            writer.close()
+
+
+async def record(args):
+    recorder = Recorder(args)
+    server = await asyncio.start_server(recorder.handle, args.host, args.port)
+    print('listening on %s:%d, writing %s' % (args.host, args.port, args.output))
+    async with server:
+        await server.serve_forever()
+
+
+def info(args):
+    first = last = None
+    records = dropped = 0
+    types = {}
+    senders = {}
+    gaps = []
+    for time_us, addr, flag, size, drop, frame in read_capture(args.capture):
+        if last is not None and time_us >= last:
+            gaps.append(time_us - last)
+        first = time_us if first is None else first
+        last = time_us
+        records += 1
+        dropped += drop
+        name = FRAME_NAMES.get(frame[0], '0x%02x' % frame[0]) if frame else 'empty'
+        types[name] = types.get(name, 0) + 1
+        senders[addr] = senders.get(addr, 0) + 1
+    if not records:
+        print('no records')
+        return
+    duration = max((last - first) / 1e6, 1e-6)
+    print('records:%d dropped_on_root:%d duration:%.1fs rate:%.1f/s senders:%d'
+          % (records, dropped, duration, records / duration, len(senders)))
+    print('types: ' + '  '.join('%s:%d' % kv for kv in sorted(types.items())))
+    if gaps:
+        gaps.sort()
+        print('inter-arrival ms  p50:%.1f p90:%.1f p99:%.1f max:%.1f'
+              % tuple(gaps[int(len(gaps) * q) - (q == 1)] / 1000.0 for q in (0.5, 0.9, 0.99, 1)))
+    busiest = sorted(senders.items(), key=lambda kv: -kv[1])[:args.top]
+    for addr, n in busiest:
+        print('  %s %d frames %.2f/s' % (mac_str(addr), n, n / duration))
+
+
+def replay(args):
+    ingest = Ingest()
+    costs = []
+    lag_max = 0.0
+    prev_us = None
+    start = time.perf_counter()
+    due = start
+    for time_us, addr, flag, size, drop, frame in read_capture(args.capture):
+        if args.speed > 0 and prev_us is not None:
+            # clock jumps (new root, reboot) replay back to back
+            delta = min(max(time_us - prev_us, 0), args.max_gap * 1e6)
+            due += delta / 1e6 / args.speed
+            now = time.perf_counter()
+            if due > now:
+                time.sleep(due - now)
+            else:
+                lag_max = max(lag_max, now - due)
+        prev_us = time_us
+        t0 = time.perf_counter()
+        ingest.frame(addr, frame)
+        costs.append(time.perf_counter() - t0)
+    elapsed = time.perf_counter() - start
+    c = ingest.counts
+    if not c['frames']:
+        print('no records')
+        return 1
+    costs.sort()
+    print('replayed %d frames in %.2fs (%.0f frames/s), speed %s, max lag %.1fms'
+          % (c['frames'], elapsed, c['frames'] / elapsed, args.speed or 'max', lag_max * 1000))
+    print('ingest us/frame  p50:%.1f p99:%.1f max:%.1f'
+          % (costs[len(costs) // 2] * 1e6, costs[int(len(costs) * 0.99)] * 1e6, costs[-1] * 1e6))
+    print('  '.join('%s:%d' % (k, c[k]) for k in ('readings', 'control', 'short', 'received',
+                                                  'duplicates', 'reordered', 'lost', 'late',
+                                                  'restarts')) + '  nodes:%d' % len(ingest.nodes))
+    return 0
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Mesh root ingress capture tool')
+    sub = parser.add_subparsers(dest='cmd')
+    sub.required = True
+    p = sub.add_parser('record', help='receive a capture from the root')
+    p.add_argument('output')
+    p.add_argument('--host', default='0.0.0.0')
+    p.add_argument('--port', type=int, default=3002)
+    p = sub.add_parser('info', help='summarize a capture')
+    p.add_argument('capture')
+    p.add_argument('--top', type=int, default=10, help='busiest senders to list')
+    p = sub.add_parser('replay', help='run a capture through the host ingest model')
+    p.add_argument('capture')
+    p.add_argument('--speed', type=float, default=1.0, help='1 original pace, 0 as fast as possible')
+    p.add_argument('--max-gap', type=float, default=10.0, help='cap idle gaps at this many seconds')
+    args = parser.parse_args()
+    try:
+        if args.cmd == 'record':
+            asyncio.run(record(args))
+        elif args.cmd == 'info':
+            info(args)
+        else:
+            sys.exit(replay(args))
+    except KeyboardInterrupt:
+        pass
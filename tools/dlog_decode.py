@@ -0,0 +1,113 @@
+#!/usr/bin/env python3
+#
+# Decoder for the deferred binary log (CONFIG_MESH_DLOG).
+#
+# The node prints "#DL <hex words>" lines holding the address of the format
+# string, the address of the tag, a timestamp, the level and the raw integer
+# arguments. This looks the strings up in the application ELF and prints the
+# lines the way ESP_LOGx would have. Other lines are passed through.
+#
+#     idf.py monitor | python3 tools/dlog_decode.py build/internal_communication.elf
+#     python3 tools/dlog_decode.py build/internal_communication.elf capture.log
+#
+# This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+import argparse
+import re
+import struct
+import sys
+
+PREFIX = '#DL '
+LEVELS = {1: 'E', 2: 'W', 3: 'I', 4: 'D', 5: 'V'}
+SPEC = re.compile(r'%([-+ #0]*)(\d+|\*)?(?:\.(\d+))?(hh|h|ll|l|z|j|t)?([diouxXcp%])')
+
+SHF_ALLOC = 0x2
+SHT_NOBITS = 8
+
+
+class Elf(object):
+
+    def __init__(self, path):
+        with open(path, 'rb') as f:
+            data = f.read()
+        if data[:4] != b'\x7fELF' or data[4] != 1:
+            raise ValueError('%s is not a 32-bit ELF' % path)
+        shoff, = struct.unpack_from('<I', data, 0x20)
+        shentsize, shnum = struct.unpack_from('<HH', data, 0x2e)
+        self.sections = []
+        for i in range(shnum):
+            _, sh_type, flags, addr, offset, size = struct.unpack_from('<IIIIII', data, shoff + i * shentsize)
+            if flags & SHF_ALLOC and sh_type != SHT_NOBITS and size:
+                self.sections.append((addr, size, data[offset:offset + size]))
+        self.cache = {}
+
+    def string(self, addr):
+        if addr in self.cache:
+            return self.cache[addr]
+        text = None
+        for start, size, blob in self.sections:
+            if start <= addr < start + size:
+                end = blob.find(b'\0', addr - start)
+                text = blob[addr - start:end if end >= 0 else size].decode('utf-8', 'replace')
+                break
+        self.cache[addr] = text
+        return text
+
+
+def render(fmt, args):
+    args = list(args)
+
+    def one(m):
+        flags, width, prec, length, conv = m.groups()
+        if conv == '%':
+            return '%'
+        value = args.pop(0) if args else 0
+        if conv in 'di' and value & 0x80000000:
+            value -= 1 << 32
+        if conv == 'p':
+            conv, flags = 'x', flags + '#'
+        spec = '%' + flags + (width if width and width != '*' else '') + ('.' + prec if prec else '') + conv
+        if conv == 'c':
+            return spec % chr(value & 0xff)
+        if conv == 'u':
+            spec = spec[:-1] + 'd'
+        return spec % value
+
+    return SPEC.sub(one, fmt)
+
+
+def decode(elf, line):
+    pos = line.find(PREFIX)
+    if pos < 0:
+        return line
+    hexwords = line[pos + len(PREFIX):].strip()
+    try:
+        words = [int(hexwords[i:i + 8], 16) for i in range(0, len(hexwords), 8)]
+        fmt_addr, tag_addr, timestamp, meta = words[:4]
+    except ValueError:
+        return line
+    args = words[4:4 + (meta & 0xff)]
+    fmt = elf.string(fmt_addr)
+    tag = elf.string(tag_addr) or '0x%08x' % tag_addr
+    if fmt is None:
+        return '%s%s (%u) %s: <format 0x%08x not in ELF> %s\n' % (
+            line[:pos], LEVELS.get(meta >> 8, '?'), timestamp, tag, fmt_addr, ' '.join('%x' % a for a in args))
+    return '%s%s (%u) %s: %s\n' % (line[:pos], LEVELS.get(meta >> 8, '?'), timestamp, tag,
+                                  render(fmt, args).rstrip('\n'))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Decode deferred binary log lines')
+    parser.add_argument('elf', help='application ELF the node runs')
+    parser.add_argument('log', nargs='?', help='captured output, stdin if omitted')
+    args = parser.parse_args()
+
+    elf = Elf(args.elf)
+    src = open(args.log, errors='replace') if args.log else sys.stdin
+    for line in src:
+        sys.stdout.write(decode(elf, line))
+        sys.stdout.flush()
+
+
+if __name__ == '__main__':
+    main()
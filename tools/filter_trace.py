@@ -0,0 +1,160 @@
+#!/usr/bin/env python3
+#
+# Run recorded DHT11 traces through the node's sample filter (main/mesh_filter.c).
+#
+# The filter source is built on the host with the system C compiler and
+# loaded with ctypes, so the code under test is the code that ships. A trace
+# is either a CSV file with temperature,humidity[,status][,expect] columns
+# (status 0 is a good read, expect is ok or drop) or node log output decoded
+# by tools/dlog_decode.py, from which the "DHT sample" lines are taken.
+# With expect columns the exit status tells whether every sample matched.
+#
+# This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+import argparse
+import csv
+import ctypes
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+RESULTS = {0: 'ok', 1: 'read_error', 2: 'range', 3: 'step'}
+QUALITY = ((0x01, 'warmup'), (0x02, 'smoothed'), (0x04, 'step'), (0x08, 'gap'))
+
+# same limits as s_filter_config in main/mesh_main.c
+DEFAULTS = {
+    'CONFIG_MESH_FILTER_WINDOW': 5,
+    'CONFIG_MESH_FILTER_STEP_CONFIRM': 3,
+    'CONFIG_MESH_FILTER_TEMPERATURE_STEP': 3,
+    'CONFIG_MESH_FILTER_HUMIDITY_STEP': 10,
+}
+TEMPERATURE_RANGE = (0, 60)
+HUMIDITY_RANGE = (5, 95)
+
+SHIM = r'''
+#include <string.h>
+#include "mesh_filter.h"
+
+static mesh_filter_t s_filter;
+
+void trace_init(int window, int confirm, int t_min, int t_max, int t_step,
+                int h_min, int h_max, int h_step)
+{
+    mesh_filter_config_t cfg = {
+        .window = window,
+        .step_confirm = confirm,
+        .temperature = { .min = t_min, .max = t_max, .max_step = t_step },
+        .humidity = { .min = h_min, .max = h_max, .max_step = h_step },
+    };
+    mesh_filter_init(&s_filter, &cfg);
+}
+
+int trace_sample(int ok, int t, int h, int *t_out, int *h_out, unsigned char *quality,
+                 unsigned char *dropped)
+{
+    return mesh_filter_sample(&s_filter, ok, t, h, t_out, h_out, quality, dropped);
+}
+'''
+
+LOG_LINE = re.compile(r'DHT sample status (-?\d+) raw (-?\d+)/(-?\d+)')
+
+
+def sdkconfig_defaults(path):
+    values = dict(DEFAULTS)
+    if os.path.exists(path):
+        for line in open(path):
+            key, _, value = line.strip().partition('=')
+            if key in values:
+                values[key] = int(value)
+    return values
+
+
+def build(tmpdir):
+    shim = os.path.join(tmpdir, 'shim.c')
+    lib = os.path.join(tmpdir, 'mesh_filter.so')
+    with open(shim, 'w') as f:
+        f.write(SHIM)
+    cc = os.environ.get('CC', 'cc')
+    subprocess.check_call([cc, '-std=gnu99', '-O2', '-Wall', '-shared', '-fPIC',
+                           '-I', os.path.join(ROOT, 'main', 'include'),
+                           os.path.join(ROOT, 'main', 'mesh_filter.c'), shim, '-o', lib])
+    return ctypes.CDLL(lib)
+
+
+def read_trace(path):
+    """Yield (status, temperature, humidity, expect) per sample."""
+    with open(path) as f:
+        first = f.readline()
+        f.seek(0)
+        if 'temperature' in first and 'humidity' in first:
+            for row in csv.DictReader(f):
+                yield (int(row.get('status') or 0), int(row['temperature']), int(row['humidity']),
+                       (row.get('expect') or '').strip() or None)
+            return
+        for line in f:
+            m = LOG_LINE.search(line)
+            if m:
+                yield int(m.group(1)), int(m.group(2)), int(m.group(3)), None
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Replay DHT11 traces through mesh_filter.c')
+    parser.add_argument('traces', nargs='+')
+    parser.add_argument('--sdkconfig', default=os.path.join(ROOT, 'sdkconfig'))
+    parser.add_argument('--window', type=int)
+    parser.add_argument('--step-confirm', type=int)
+    parser.add_argument('--temperature-step', type=int)
+    parser.add_argument('--humidity-step', type=int)
+    parser.add_argument('-v', '--verbose', action='store_true', help='print every sample')
+    args = parser.parse_args()
+
+    cfg = sdkconfig_defaults(args.sdkconfig)
+    window = args.window or cfg['CONFIG_MESH_FILTER_WINDOW']
+    confirm = args.step_confirm or cfg['CONFIG_MESH_FILTER_STEP_CONFIRM']
+    t_step = args.temperature_step or cfg['CONFIG_MESH_FILTER_TEMPERATURE_STEP']
+    h_step = args.humidity_step or cfg['CONFIG_MESH_FILTER_HUMIDITY_STEP']
+
+    t_out, h_out = ctypes.c_int(), ctypes.c_int()
+    quality, dropped = ctypes.c_ubyte(), ctypes.c_ubyte()
+    mismatches = 0
+    with tempfile.TemporaryDirectory() as tmpdir:
+        lib = build(tmpdir)
+        for path in args.traces:
+            lib.trace_init(window, confirm, TEMPERATURE_RANGE[0], TEMPERATURE_RANGE[1], t_step,
+                           HUMIDITY_RANGE[0], HUMIDITY_RANGE[1], h_step)
+            counts = dict.fromkeys(RESULTS.values(), 0)
+            flags = dict.fromkeys((name for _, name in QUALITY), 0)
+            samples = 0
+            for n, (status, t, h, expect) in enumerate(read_trace(path), 1):
+                samples += 1
+                result = lib.trace_sample(status == 0, t, h, ctypes.byref(t_out), ctypes.byref(h_out),
+                                          ctypes.byref(quality), ctypes.byref(dropped))
+                name = RESULTS.get(result, str(result))
+                counts[name] = counts.get(name, 0) + 1
+                if result == 0:
+                    for bit, flag in QUALITY:
+                        if quality.value & bit:
+                            flags[flag] += 1
+                if expect and (expect == 'ok') != (result == 0):
+                    mismatches += 1
+                    print('%s:%d: raw %d/%d status %d gave %s, expected %s'
+                          % (path, n, t, h, status, name, expect))
+                if args.verbose:
+                    out = '%d/%d q:0x%02x d:%d' % (t_out.value, h_out.value, quality.value,
+                                                    dropped.value) if result == 0 else '-'
+                    print('%6d raw %3d/%3d status %2d  %-10s %s' % (n, t, h, status, name, out))
+            print('%s: samples:%d %s  flags: %s' % (
+                path, samples, ' '.join('%s:%d' % (k, counts[k]) for k in RESULTS.values()),
+                ' '.join('%s:%d' % kv for kv in flags.items())))
+    if mismatches:
+        print('%d samples did not match their expect column' % mismatches)
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,150 @@
+#!/usr/bin/env python3
+#
+# Run ingest traces through the soak recovery tracker (main/mesh_recovery.c).
+#
+# The tracker source is built on the host with the system C compiler and
+# loaded with ctypes, so the code under test is the code that ships. A trace
+# is a CSV file with time_s,rx[,mark][,expect] columns, one row per second:
+# rx is the number of frames the root received in that second, mark is
+# disrupted or connected and happens just before that second's tick. Seconds
+# left out repeat the rx of the row before. expect lists what the tick should
+# report, joined with "+" (start, nested, connected, throughput, settled) and
+# empty for nothing. With expect columns the exit status tells whether every
+# second matched.
+#
+# This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+import argparse
+import csv
+import ctypes
+import os
+import subprocess
+import sys
+import tempfile
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+RATE_SECONDS = 10   # MESH_RECOVERY_RATE_SECONDS
+THROUGHPUT = 1 << 0
+SETTLED = 1 << 1
+
+SHIM = r'''
+#include <string.h>
+#include "mesh_recovery.h"
+
+static mesh_recovery_t s_recovery;
+
+void trace_reset(void)
+{
+    memset(&s_recovery, 0, sizeof(s_recovery));
+}
+
+mesh_recovery_t *trace_recovery(void)
+{
+    return &s_recovery;
+}
+'''
+
+
+class Recovery(ctypes.Structure):
+    _fields_ = [('rx_per_s', ctypes.c_uint32 * RATE_SECONDS),
+                ('rx_last', ctypes.c_uint32),
+                ('slot', ctypes.c_int),
+                ('samples', ctypes.c_uint32),
+                ('open', ctypes.c_bool),
+                ('connected', ctypes.c_bool),
+                ('throughput_back', ctypes.c_bool),
+                ('start_us', ctypes.c_int64),
+                ('connected_us', ctypes.c_int64),
+                ('throughput_ms', ctypes.c_uint32),
+                ('baseline', ctypes.c_uint32)]
+
+
+def build(tmpdir):
+    shim = os.path.join(tmpdir, 'shim.c')
+    lib = os.path.join(tmpdir, 'mesh_recovery.so')
+    with open(shim, 'w') as f:
+        f.write(SHIM)
+    cc = os.environ.get('CC', 'cc')
+    subprocess.check_call([cc, '-std=gnu99', '-O2', '-Wall', '-shared', '-fPIC',
+                           '-I', os.path.join(ROOT, 'main', 'include'),
+                           os.path.join(ROOT, 'main', 'mesh_recovery.c'), shim, '-o', lib])
+    lib = ctypes.CDLL(lib)
+    rec_p = ctypes.POINTER(Recovery)
+    lib.trace_recovery.restype = rec_p
+    lib.mesh_recovery_sample.argtypes = [rec_p, ctypes.c_uint32]
+    lib.mesh_recovery_start.argtypes = [rec_p, ctypes.c_int64]
+    lib.mesh_recovery_start.restype = ctypes.c_bool
+    lib.mesh_recovery_connected.argtypes = [rec_p, ctypes.c_int64, ctypes.POINTER(ctypes.c_uint32)]
+    lib.mesh_recovery_connected.restype = ctypes.c_bool
+    lib.mesh_recovery_track.argtypes = [rec_p, ctypes.c_int64]
+    return lib
+
+
+def read_trace(path):
+    """Yield (second, rx, mark, expect) per second, filling the gaps between rows."""
+    last = None
+    with open(path) as f:
+        for row in csv.DictReader(f):
+            second, rx = int(row['time_s']), int(row['rx'])
+            if last is not None:
+                for gap in range(last[0] + 1, second):
+                    yield gap, last[1], None, ''
+            yield second, rx, (row.get('mark') or '').strip() or None, row.get('expect')
+            last = (second, rx)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Replay ingest traces through mesh_recovery.c')
+    parser.add_argument('traces', nargs='+')
+    parser.add_argument('-v', '--verbose', action='store_true', help='print every second')
+    args = parser.parse_args()
+
+    mismatches = 0
+    with tempfile.TemporaryDirectory() as tmpdir:
+        lib = build(tmpdir)
+        rec = lib.trace_recovery()
+        for path in args.traces:
+            lib.trace_reset()
+            total = 0
+            events = 0
+            for second, rx, mark, expect in read_trace(path):
+                now_us = second * 1000000
+                got = []
+                if mark == 'disrupted':
+                    got.append('start' if lib.mesh_recovery_start(rec, now_us) else 'nested')
+                elif mark == 'connected':
+                    ms = ctypes.c_uint32()
+                    if lib.mesh_recovery_connected(rec, now_us, ctypes.byref(ms)):
+                        got.append('connected')
+                elif mark:
+                    print('%s:%ds: unknown mark %s' % (path, second, mark))
+                total += rx
+                lib.mesh_recovery_sample(rec, total)
+                result = lib.mesh_recovery_track(rec, now_us)
+                if result & THROUGHPUT:
+                    got.append('throughput')
+                if result & SETTLED:
+                    got.append('settled')
+                    events += 1
+                    r = rec.contents
+                    print('%s:%ds: connect:%dms throughput:%dms baseline:%u/%ds' % (
+                        path, second,
+                        (r.connected_us - r.start_us) // 1000 if r.connected else -1,
+                        r.throughput_ms if r.throughput_back else -1,
+                        r.baseline, RATE_SECONDS))
+                got = '+'.join(got)
+                if expect is not None and expect.strip() != got:
+                    mismatches += 1
+                    print('%s:%ds: gave %s, expected %s' % (path, second, got or '-', expect.strip() or '-'))
+                if args.verbose:
+                    print('%6d %4d %-10s %s' % (second, rx, mark or '', got))
+            print('%s: settled events:%d' % (path, events))
+    if mismatches:
+        print('%d seconds did not match their expect column' % mismatches)
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
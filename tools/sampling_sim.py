@@ -0,0 +1,257 @@
+#!/usr/bin/env python3
+#
+# Simulate adaptive sampling (main/mesh_rate.c) and the root budget
+# (main/mesh_budget.c) on dense sensor traces.
+#
+# Each trace is one node: a CSV file with [time_s,]temperature,humidity[,status]
+# columns (without time_s samples are 2 s apart) or node log output decoded by
+# tools/dlog_decode.py, from which the "DHT sample" lines are taken. Record the
+# traces with CONFIG_MESH_RATE_MAX_INTERVAL_MS equal to the minimum so every
+# sample is there. The rate controller is built on the host with the system C
+# compiler and loaded with ctypes; the root budget is modelled here and applied
+# to all nodes at the end of each period.
+#
+# Reported per node: readings sent against a fixed cadence at the shortest
+# interval, and the error of the values the root holds between readings.
+#
+# This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+import argparse
+import csv
+import ctypes
+import heapq
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+DEFAULTS = {
+    'CONFIG_MESH_RATE_MIN_INTERVAL_MS': 2000,
+    'CONFIG_MESH_RATE_MAX_INTERVAL_MS': 30000,
+    'CONFIG_MESH_RATE_CALM_X100': 20,
+    'CONFIG_MESH_RATE_BUSY_X100': 200,
+    'CONFIG_MESH_RATE_BUDGET_X100': 1000,
+    'CONFIG_MESH_RATE_BUDGET_PERIOD_S': 10,
+}
+SAMPLE_PERIOD_S = 2.0
+BUDGET_LOW_PCT = 80
+MAX_NODES = 64
+
+SHIM = r'''
+#include "mesh_rate.h"
+
+static mesh_rate_t s_rates[%d];
+
+void sim_init(int node, unsigned min_ms, unsigned max_ms, unsigned calm, unsigned busy)
+{
+    mesh_rate_config_t cfg = {
+        .min_interval_ms = min_ms,
+        .max_interval_ms = max_ms,
+        .calm_x100 = calm,
+        .busy_x100 = busy,
+    };
+    mesh_rate_init(&s_rates[node], &cfg);
+}
+
+unsigned sim_update(int node, int t, int h, unsigned elapsed_ms, unsigned floor_ms)
+{
+    return mesh_rate_update(&s_rates[node], t, h, elapsed_ms, floor_ms);
+}
+
+unsigned sim_volatility(int node)
+{
+    return s_rates[node].volatility_x100;
+}
+''' % MAX_NODES
+
+LOG_LINE = re.compile(r'DHT sample status (-?\d+) raw (-?\d+)/(-?\d+)')
+
+
+def sdkconfig_defaults(path):
+    values = dict(DEFAULTS)
+    if os.path.exists(path):
+        for line in open(path):
+            key, _, value = line.strip().partition('=')
+            if key in values:
+                values[key] = int(value)
+    return values
+
+
+def build(tmpdir):
+    shim = os.path.join(tmpdir, 'shim.c')
+    lib = os.path.join(tmpdir, 'mesh_rate.so')
+    with open(shim, 'w') as f:
+        f.write(SHIM)
+    cc = os.environ.get('CC', 'cc')
+    subprocess.check_call([cc, '-std=gnu99', '-O2', '-Wall', '-shared', '-fPIC',
+                           '-I', os.path.join(ROOT, 'main', 'include'),
+                           os.path.join(ROOT, 'main', 'mesh_rate.c'), shim, '-o', lib])
+    lib = ctypes.CDLL(lib)
+    lib.sim_update.restype = ctypes.c_uint
+    lib.sim_volatility.restype = ctypes.c_uint
+    return lib
+
+
+def read_trace(path):
+    """Return [(time_s, temperature, humidity)] of the good samples."""
+    samples = []
+    with open(path) as f:
+        first = f.readline()
+        f.seek(0)
+        if 'temperature' in first and 'humidity' in first:
+            for n, row in enumerate(csv.DictReader(f)):
+                if int(row.get('status') or 0) != 0:
+                    continue
+                ts = float(row['time_s']) if row.get('time_s') else n * SAMPLE_PERIOD_S
+                samples.append((ts, int(row['temperature']), int(row['humidity'])))
+            return samples
+        n = 0
+        for line in f:
+            m = LOG_LINE.search(line)
+            if m:
+                if int(m.group(1)) == 0:
+                    samples.append((n * SAMPLE_PERIOD_S, int(m.group(2)), int(m.group(3))))
+                n += 1
+    return samples
+
+
+def next_floor(floor_ms, load_x100, cfg):
+    """Same steps as budget_next_floor in main/mesh_budget.c."""
+    budget = cfg['CONFIG_MESH_RATE_BUDGET_X100']
+    min_ms = cfg['CONFIG_MESH_RATE_MIN_INTERVAL_MS']
+    max_ms = cfg['CONFIG_MESH_RATE_MAX_INTERVAL_MS']
+    if load_x100 > budget:
+        return min(max(floor_ms, min_ms) * load_x100 // budget, max_ms)
+    if floor_ms and load_x100 * 100 < budget * BUDGET_LOW_PCT:
+        floor_ms = floor_ms * 4 // 5
+        return floor_ms if floor_ms > min_ms else 0
+    return floor_ms
+
+
+class Node(object):
+
+    def __init__(self, path, samples):
+        self.path = path
+        self.samples = samples
+        self.sent = 0
+        self.next_due = None
+        self.last_sent = None
+        self.held = None
+        self.err_t = []
+        self.err_h = []
+        self.intervals = []
+
+
+def simulate(lib, nodes, cfg):
+    min_ms = cfg['CONFIG_MESH_RATE_MIN_INTERVAL_MS']
+    period = cfg['CONFIG_MESH_RATE_BUDGET_PERIOD_S']
+    budgeted = cfg['CONFIG_MESH_RATE_BUDGET_X100'] > 0
+    for i, node in enumerate(nodes):
+        lib.sim_init(i, min_ms, cfg['CONFIG_MESH_RATE_MAX_INTERVAL_MS'],
+                     cfg['CONFIG_MESH_RATE_CALM_X100'], cfg['CONFIG_MESH_RATE_BUSY_X100'])
+
+    floor_ms = 0
+    floors = []
+    loads = []
+    window = 0
+    budget_at = None
+    events = heapq.merge(*[[(ts, i, t, h) for ts, t, h in node.samples]
+                           for i, node in enumerate(nodes)])
+    for ts, i, t, h in events:
+        if budget_at is None:
+            budget_at = ts + period
+        while budgeted and ts >= budget_at:
+            load_x100 = window * 100 // period
+            loads.append(load_x100)
+            floor_ms = next_floor(floor_ms, load_x100, cfg)
+            floors.append(floor_ms)
+            window = 0
+            budget_at += period
+
+        node = nodes[i]
+        if node.next_due is None or ts >= node.next_due:
+            elapsed_ms = int((ts - node.last_sent) * 1000) if node.last_sent is not None else 0
+            interval = lib.sim_update(i, t, h, elapsed_ms, floor_ms)
+            node.intervals.append(interval)
+            node.next_due = ts + interval / 1000.0
+            node.last_sent = ts
+            node.held = (t, h)
+            node.sent += 1
+            window += 1
+        node.err_t.append(abs(t - node.held[0]))
+        node.err_h.append(abs(h - node.held[1]))
+    return loads, floors
+
+
+def fixed_count(samples, interval_s):
+    """Readings a node sending every interval_s would have sent."""
+    count = 0
+    due = None
+    for ts, _, _ in samples:
+        if due is None or ts >= due:
+            count += 1
+            due = ts + interval_s
+    return count
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Simulate adaptive sampling on recorded traces')
+    parser.add_argument('traces', nargs='+', help='one trace per node')
+    parser.add_argument('--sdkconfig', default=os.path.join(ROOT, 'sdkconfig'))
+    parser.add_argument('--min-interval-ms', type=int)
+    parser.add_argument('--max-interval-ms', type=int)
+    parser.add_argument('--calm-x100', type=int)
+    parser.add_argument('--busy-x100', type=int)
+    parser.add_argument('--budget-x100', type=int, help='0 disables the root budget')
+    parser.add_argument('--budget-period-s', type=int)
+    args = parser.parse_args()
+
+    cfg = sdkconfig_defaults(args.sdkconfig)
+    for key, value in (('MIN_INTERVAL_MS', args.min_interval_ms),
+                       ('MAX_INTERVAL_MS', args.max_interval_ms),
+                       ('CALM_X100', args.calm_x100), ('BUSY_X100', args.busy_x100),
+                       ('BUDGET_X100', args.budget_x100),
+                       ('BUDGET_PERIOD_S', args.budget_period_s)):
+        if value is not None:
+            cfg['CONFIG_MESH_RATE_' + key] = value
+    if len(args.traces) > MAX_NODES:
+        parser.error('at most %d traces' % MAX_NODES)
+
+    nodes = []
+    for path in args.traces:
+        samples = read_trace(path)
+        if not samples:
+            print('%s: no samples' % path)
+            continue
+        nodes.append(Node(path, samples))
+    if not nodes:
+        return 1
+    with tempfile.TemporaryDirectory() as tmpdir:
+        lib = build(tmpdir)
+        loads, floors = simulate(lib, nodes, cfg)
+
+    min_s = cfg['CONFIG_MESH_RATE_MIN_INTERVAL_MS'] / 1000.0
+    total = fixed_total = 0
+    for node in nodes:
+        fixed = fixed_count(node.samples, min_s)
+        total += node.sent
+        fixed_total += fixed
+        n = len(node.err_t)
+        print('%s: sent:%d fixed:%d (%.0f%%) interval ms min:%d max:%d  '
+              'temperature err mean:%.2f max:%d  humidity err mean:%.2f max:%d'
+              % (node.path, node.sent, fixed, 100.0 * node.sent / fixed,
+                 min(node.intervals), max(node.intervals),
+                 sum(node.err_t) / n, max(node.err_t), sum(node.err_h) / n, max(node.err_h)))
+    print('total sent:%d fixed:%d (%.0f%%)' % (total, fixed_total, 100.0 * total / fixed_total))
+    if loads:
+        print('root load x100 max:%d budget:%d  floor ms max:%d periods with floor:%d/%d'
+              % (max(loads), cfg['CONFIG_MESH_RATE_BUDGET_X100'], max(floors),
+                 sum(1 for f in floors if f), len(floors)))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,130 @@
+#!/usr/bin/env python3
+#
+# Run sequence traces through the root's dedup window (main/mesh_seq.c).
+#
+# The window source is built on the host with the system C compiler and
+# loaded with ctypes, so the code under test is the code that ships. A trace
+# is either a CSV file with [address,]session,seq[,expect] columns (session in
+# hex, expect is new, reordered, restart or duplicate) or root log output
+# decoded by tools/dlog_decode.py, from which the "#RX" lines are taken.
+# Every sender address gets its own window. With expect columns the exit
+# status tells whether every frame matched.
+#
+# This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+import argparse
+import csv
+import ctypes
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+RESULTS = {0: 'new', 1: 'reordered', 2: 'restart', 3: 'duplicate'}
+STATS = ('received', 'duplicates', 'reordered', 'lost', 'late', 'restarts')
+MAX_NODES = 64
+
+SHIM = r'''
+#include <string.h>
+#include "mesh_seq.h"
+
+static mesh_seq_window_t s_windows[%d];
+static mesh_seq_stats_t s_stats;
+
+void trace_reset(void)
+{
+    memset(s_windows, 0, sizeof(s_windows));
+    memset(&s_stats, 0, sizeof(s_stats));
+}
+
+int trace_frame(int node, unsigned session, unsigned seq)
+{
+    return mesh_seq_check(&s_windows[node], &s_stats, session, seq);
+}
+
+const mesh_seq_stats_t *trace_stats(void)
+{
+    return &s_stats;
+}
+''' % MAX_NODES
+
+LOG_LINE = re.compile(r'#RX:id -?\d+ seq ([0-9a-f]+):(\d+) .*receive from ([0-9a-f:]{17})')
+
+
+class SeqStats(ctypes.Structure):
+    _fields_ = [(name, ctypes.c_uint32) for name in STATS]
+
+
+def build(tmpdir):
+    shim = os.path.join(tmpdir, 'shim.c')
+    lib = os.path.join(tmpdir, 'mesh_seq.so')
+    with open(shim, 'w') as f:
+        f.write(SHIM)
+    cc = os.environ.get('CC', 'cc')
+    subprocess.check_call([cc, '-std=gnu99', '-O2', '-Wall', '-shared', '-fPIC',
+                           '-I', os.path.join(ROOT, 'main', 'include'),
+                           os.path.join(ROOT, 'main', 'mesh_seq.c'), shim, '-o', lib])
+    lib = ctypes.CDLL(lib)
+    lib.trace_stats.restype = ctypes.POINTER(SeqStats)
+    return lib
+
+
+def read_trace(path):
+    """Yield (address, session, seq, expect) per frame."""
+    with open(path) as f:
+        first = f.readline()
+        f.seek(0)
+        if 'session' in first and 'seq' in first:
+            for row in csv.DictReader(f):
+                yield (row.get('address') or '-', int(row['session'], 16), int(row['seq']),
+                       (row.get('expect') or '').strip() or None)
+            return
+        for line in f:
+            m = LOG_LINE.search(line)
+            if m:
+                yield m.group(3), int(m.group(1), 16), int(m.group(2)), None
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Replay sequence traces through mesh_seq.c')
+    parser.add_argument('traces', nargs='+')
+    parser.add_argument('-v', '--verbose', action='store_true', help='print every frame')
+    args = parser.parse_args()
+
+    mismatches = 0
+    with tempfile.TemporaryDirectory() as tmpdir:
+        lib = build(tmpdir)
+        for path in args.traces:
+            lib.trace_reset()
+            nodes = {}
+            counts = dict.fromkeys(RESULTS.values(), 0)
+            frames = 0
+            for n, (addr, session, seq, expect) in enumerate(read_trace(path), 1):
+                if addr not in nodes:
+                    if len(nodes) >= MAX_NODES:
+                        continue
+                    nodes[addr] = len(nodes)
+                frames += 1
+                name = RESULTS.get(lib.trace_frame(nodes[addr], session, seq))
+                counts[name] += 1
+                if expect and expect != name:
+                    mismatches += 1
+                    print('%s:%d: %s %04x:%d gave %s, expected %s'
+                          % (path, n, addr, session, seq, name, expect))
+                if args.verbose:
+                    print('%6d %s %04x:%-8d %s' % (n, addr, session, seq, name))
+            stats = lib.trace_stats().contents
+            print('%s: frames:%d senders:%d %s  stats: %s' % (
+                path, frames, len(nodes), ' '.join('%s:%d' % kv for kv in counts.items()),
+                ' '.join('%s:%d' % (k, getattr(stats, k)) for k in STATS)))
+    if mismatches:
+        print('%d frames did not match their expect column' % mismatches)
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
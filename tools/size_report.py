@@ -0,0 +1,224 @@
+#!/usr/bin/env python3
+#
+# Compare the footprint of node role builds (MESH_ROLE) from their linker maps.
+#
+# Build each profile into its own directory, for example
+#
+#   idf.py -B build-leaf -D SDKCONFIG=build-leaf/sdkconfig \
+#          -D SDKCONFIG_DEFAULTS="sdkconfig;profiles/sdkconfig.leaf" build
+#
+# then pass the maps, optionally as name=path. Without arguments every
+# build*/*.map is used. The first map is the baseline, the other columns show
+# the difference to it. Sizes come from the input sections the linker placed,
+# so flash and static RAM are exact; heap use has to be read on the node.
+#
+# This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+import argparse
+import glob
+import os
+import re
+import sys
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+REGIONS = ('flash_code', 'flash_rodata', 'iram', 'dram_data', 'dram_bss', 'rtc')
+
+OUTPUT_SECTION = re.compile(r'^(\.\S+)(?:\s+0x([0-9a-f]+)\s+0x([0-9a-f]+))?\s*$')
+INPUT_SECTION = re.compile(r'^ (\S+)(?:\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)(?:\s+(\S.*))?)?\s*$')
+ADDR_SIZE = re.compile(r'^\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)(?:\s+(\S.*))?\s*$')
+ARCHIVE_MEMBER = re.compile(r'([^/\\]+\.a)\((.+)\)$')
+
+
+def region(name):
+    """Memory a section of the application image ends up in, None for debug info."""
+    if name.startswith('.flash.text'):
+        return 'flash_code'
+    if name.startswith('.flash.'):
+        return 'flash_rodata'
+    if name.startswith('.iram'):
+        return 'iram'
+    if name.startswith('.rtc'):
+        return 'rtc'
+    if name.startswith('.dram') or name.startswith('.noinit'):
+        return 'dram_bss' if 'bss' in name or 'noinit' in name else 'dram_data'
+    return None
+
+
+def source_key(source):
+    """(archive, object) for an input section source."""
+    if not source:
+        return '(fill)', '(fill)'
+    m = ARCHIVE_MEMBER.search(source)
+    if m:
+        return m.group(1), m.group(2)
+    name = os.path.basename(source)
+    return name, name
+
+
+class MapSizes(object):
+
+    def __init__(self, name, path):
+        self.name = name
+        self.path = path
+        self.regions = dict.fromkeys(REGIONS, 0)
+        self.archives = {}
+        self.objects = {}
+
+    def add(self, where, size, source):
+        if not where or not size:
+            return
+        archive, obj = source_key(source)
+        self.regions[where] += size
+        per = self.archives.setdefault(archive, dict.fromkeys(REGIONS, 0))
+        per[where] += size
+        if archive == 'libmain.a':
+            per = self.objects.setdefault(obj, dict.fromkeys(REGIONS, 0))
+            per[where] += size
+
+    def flash(self, sizes=None):
+        r = sizes or self.regions
+        return r['flash_code'] + r['flash_rodata'] + r['iram'] + r['dram_data'] + r['rtc']
+
+    def ram(self, sizes=None):
+        r = sizes or self.regions
+        return r['dram_data'] + r['dram_bss']
+
+
+def parse_map(name, path):
+    sizes = MapSizes(name, path)
+    where = None
+    end = 0             # of the current output section, 0 while unknown
+    pending = None      # input section name waiting for its address line
+    last = None         # (address, size, source) not yet counted
+    in_map = False
+
+    def flush(next_addr):
+        # merged string sections list their size before merging and overlap
+        # whatever the linker placed next, count them up to that point only
+        addr, size, source = last
+        if next_addr and addr <= next_addr < addr + size:
+            size = next_addr - addr
+        sizes.add(where, size, source)
+
+    with open(path) as f:
+        for line in f:
+            line = line.rstrip('\n')
+            if not in_map:
+                in_map = line.startswith('Linker script and memory map')
+                continue
+            if line.startswith('.'):
+                m = OUTPUT_SECTION.match(line)
+                if m:
+                    if last:
+                        flush(end)
+                        last = None
+                    where = region(m.group(1))
+                    end = 0
+                    if m.group(2) is not None:
+                        end = int(m.group(2), 16) + int(m.group(3), 16)
+                        # a zero address is debug or comment data, not loaded
+                        if not int(m.group(2), 16):
+                            where = None
+                    pending = m.group(1) if m.group(2) is None else None
+                continue
+            m = ADDR_SIZE.match(line) if pending is not None else None
+            if m:
+                addr, size, source = int(m.group(1), 16), int(m.group(2), 16), m.group(3)
+                pending = None
+                if not source:
+                    # address line of an output section header
+                    end = addr + size
+                    if not addr:
+                        where = None
+                    continue
+            else:
+                pending = None
+                m = INPUT_SECTION.match(line)
+                if not m or m.group(1).startswith('*(') or m.group(1).startswith('0x'):
+                    continue
+                if m.group(2) is None:
+                    if m.group(1) != '*fill*':
+                        pending = m.group(1)
+                    continue
+                addr, size = int(m.group(2), 16), int(m.group(3), 16)
+                source = None if m.group(1) == '*fill*' else m.group(4)
+            if last:
+                flush(addr)
+            last = (addr, size, source)
+        if last:
+            flush(end)
+    if not in_map:
+        raise ValueError('%s: no memory map, not a GNU ld map file' % path)
+    return sizes
+
+
+def profile_name(path):
+    """build-leaf/internal_communication.map -> leaf."""
+    parent = os.path.basename(os.path.dirname(os.path.abspath(path)))
+    for prefix in ('build-', 'build_'):
+        if parent.startswith(prefix):
+            return parent[len(prefix):]
+    return parent
+
+
+def cell(value, base, first):
+    if first:
+        return '%10d' % value
+    return '%+10d' % (value - base)
+
+
+def print_table(title, rows, maps):
+    print('%-24s' % title + ''.join('%10s' % m.name[:10] for m in maps))
+    for label, values in rows:
+        print('%-24s' % label[:24] + ''.join(cell(v, values[0], i == 0) for i, v in enumerate(values)))
+    print('')
+
+
+def report(maps, top):
+    rows = [('flash image', [m.flash() for m in maps]),
+            ('static DRAM', [m.ram() for m in maps])]
+    rows += [('  ' + r, [m.regions[r] for m in maps]) for r in REGIONS]
+    print_table('bytes', rows, maps)
+
+    for attr, title in (('archives', 'archive flash'), ('objects', 'main object flash')):
+        names = set()
+        for m in maps:
+            names.update(getattr(m, attr))
+        keyed = []
+        for n in names:
+            flash = [m.flash(getattr(m, attr).get(n, dict.fromkeys(REGIONS, 0))) for m in maps]
+            ram = [m.ram(getattr(m, attr).get(n, dict.fromkeys(REGIONS, 0))) for m in maps]
+            keyed.append((n, flash, ram))
+        # what changes between profiles first, then the largest
+        keyed.sort(key=lambda k: (-(max(k[1]) - min(k[1]) + max(k[2]) - min(k[2])), -max(k[1])))
+        print_table(title, [(n, flash) for n, flash, _ in keyed[:top]], maps)
+        print_table(title.replace('flash', 'DRAM'), [(n, ram) for n, _, ram in keyed[:top]], maps)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Footprint of MESH_ROLE builds from linker maps')
+    parser.add_argument('maps', nargs='*', help='[name=]path of an application .map file')
+    parser.add_argument('--top', type=int, default=15, help='rows per breakdown table')
+    args = parser.parse_args()
+
+    specs = args.maps or sorted(p for p in glob.glob(os.path.join(ROOT, 'build*', '*.map')))
+    if not specs:
+        print('no build*/*.map found, build the profiles first')
+        return 1
+    maps = []
+    for spec in specs:
+        name, sep, path = spec.partition('=')
+        if not sep:
+            name, path = profile_name(spec), spec
+        try:
+            maps.append(parse_map(name, path))
+        except (IOError, ValueError) as e:
+            print(e)
+            return 1
+    report(maps, args.top)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
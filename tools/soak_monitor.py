@@ -0,0 +1,80 @@
+#!/usr/bin/env python3
+#
+# Soak run monitor for CONFIG_MESH_FAULT_INJECTION builds.
+#
+# Polls the root's /stats endpoint for the length of a soak run, follows the
+# root across failovers, and prints recovery times, readings lost per
+# disruption and heap drift at the end.
+#
+# This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+import argparse
+import csv
+import json
+import sys
+import time
+import urllib.request
+
+
+def fetch(host, port, timeout):
+    with urllib.request.urlopen('http://%s:%d/stats' % (host, port), timeout=timeout) as resp:
+        return json.loads(resp.read().decode())
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Mesh soak run monitor')
+    parser.add_argument('hosts', nargs='+', help='addresses the root may come up on')
+    parser.add_argument('--port', type=int, default=80)
+    parser.add_argument('--hours', type=float, default=4.0)
+    parser.add_argument('--interval', type=float, default=10.0, help='seconds between polls')
+    parser.add_argument('--csv', help='write every sample to this file')
+    args = parser.parse_args()
+
+    out = csv.writer(open(args.csv, 'w', newline='')) if args.csv else None
+    if out:
+        out.writerow(['time', 'host', 'uptime', 'received', 'lost', 'heap', 'heap_min',
+                      'events', 'injected', 'connect_ms_max', 'throughput_ms_max', 'fault_lost'])
+
+    end = time.time() + args.hours * 3600
+    samples = []
+    unreachable = 0
+    while time.time() < end:
+        stats = None
+        for host in args.hosts:
+            try:
+                stats = fetch(host, args.port, 5)
+                break
+            except (OSError, ValueError):
+                continue
+        if stats is None:
+            unreachable += 1
+        else:
+            faults = stats.get('faults', {})
+            samples.append(stats)
+            if out:
+                out.writerow([int(time.time()), host, stats['uptime'], stats['received'], stats['lost'],
+                              stats['heap'], stats['heap_min'], faults.get('events', 0),
+                              faults.get('injected', 0), faults.get('connect_ms_max', 0),
+                              faults.get('throughput_ms_max', 0), faults.get('lost', 0)])
+        time.sleep(args.interval)
+
+    if not samples:
+        print('root never reachable')
+        sys.exit(1)
+    last = samples[-1]
+    faults = last.get('faults', {})
+    events = max(faults.get('events', 0), 1)
+    print('samples:%d unreachable:%d' % (len(samples), unreachable))
+    print('disruptions:%d injected:%d' % (faults.get('events', 0), faults.get('injected', 0)))
+    print('connect ms avg:%d max:%d' % (faults.get('connect_ms_avg', 0), faults.get('connect_ms_max', 0)))
+    print('throughput recovery ms avg:%d max:%d' % (faults.get('throughput_ms_avg', 0),
+                                                    faults.get('throughput_ms_max', 0)))
+    print('readings lost:%d per disruption:%.1f' % (faults.get('lost', 0), faults.get('lost', 0) / float(events)))
+    print('root switches:%d readings lost:%d' % (faults.get('root_switches', 0),
+                                                 faults.get('root_switch_lost', 0)))
+    print('heap first:%d last:%d min:%d drift:%d' % (samples[0]['heap'], last['heap'], last['heap_min'],
+                                                     faults.get('heap_drift', 0)))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,193 @@
+#!/usr/bin/env python3
+#
+# Reference collector for the root's binary TCP uplink (CONFIG_MESH_UPLINK_STREAM).
+#
+# Decodes the length-prefixed record stream, acknowledges what it has stored
+# so a reconnecting root resumes from the right sequence, and prints the
+# ingest rate. Message layout matches main/include/mesh_stream.h.
+#
+# This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+import argparse
+import asyncio
+import struct
+import sys
+import time
+
+MAGIC = 0x5254534d
+VERSION = 3
+
+MSG_HELLO = 0x01
+MSG_RECORD = 0x02
+MSG_ACK = 0x81
+
+HDR = struct.Struct('<HB')
+HELLO = struct.Struct('<IB6sII')
+RECORD = struct.Struct('<II6sIHBBbB')
+ACK = struct.Struct('<I')
+
+# node sequences remembered per sender, enough to span a root handoff
+NODE_WINDOW = 1024
+
+
+def mac_str(mac):
+    return ':'.join('%02x' % b for b in mac)
+
+
+class Collector(object):
+
+    def __init__(self, args):
+        self.args = args
+        # (root mac, session) -> last contiguous sequence stored
+        self.last_seq = {}
+        # sender mac -> (node_session, highest node_seq, node_seqs stored within NODE_WINDOW of it)
+        self.node_seen = {}
+        self.records = 0
+        self.duplicates = 0
+        self.handoff_duplicates = 0
+        self.gaps = 0
+        self.bytes = 0
+        self.window_records = 0
+        self.window_bytes = 0
+        self.window_start = time.monotonic()
+        self.out = open(args.csv, 'a') if args.csv else None
+
+    def ack(self, writer, seq):
+        writer.write(HDR.pack(1 + ACK.size, MSG_ACK) + ACK.pack(seq))
+
+    def seen_before(self, addr, node_session, node_seq):
+        # a reading handed to a new root can arrive from both roots
+        session, high, seen = self.node_seen.get(addr, (node_session, 0, set()))
+        if node_session != session:
+            # sender rebooted, node_seq starts over
+            high, seen = 0, set()
+        if node_seq in seen:
+            return True
+        seen.add(node_seq)
+        if node_seq > high:
+            high = node_seq
+            if len(seen) > 2 * NODE_WINDOW:
+                seen = set(n for n in seen if n + NODE_WINDOW >= high)
+        self.node_seen[addr] = (node_session, high, seen)
+        return False
+
+    def store(self, key, rec):
+        seq, ts, addr, node_seq, node_session, node_id, layer, temperature, humidity = rec
+        last = self.last_seq[key]
+        if seq <= last:
+            self.duplicates += 1
+            return
+        if seq > last + 1:
+            # the root overwrote these before they could be sent
+            self.gaps += seq - last - 1
+        self.last_seq[key] = seq
+        if self.seen_before(addr, node_session, node_seq):
+            self.handoff_duplicates += 1
+            return
+        self.records += 1
+        self.window_records += 1
+        if self.out:
+            self.out.write('%s,%d,%d,%s,%d,%d,%d,%d,%d,%d\n'
+                           % (mac_str(key[0]), seq, ts, mac_str(addr), node_session, node_seq,
+                              node_id, layer, temperature, humidity))
+        if self.args.verbose:
+            print('%s seq:%d id:%d addr:%s node_seq:%04x:%d L:%d temperature:%d humidity:%d'
+                  % (mac_str(key[0]), seq, node_id, mac_str(addr), node_session, node_seq, layer,
+                     temperature, humidity))
+
+    def report(self):
+        now = time.monotonic()
+        elapsed = now - self.window_start
+        print('records/s:%.1f  kB/s:%.2f  total:%d  duplicates:%d  handoff_duplicates:%d  lost:%d'
+              % (self.window_records / elapsed, self.window_bytes / elapsed / 1024.0,
+                 self.records, self.duplicates, self.handoff_duplicates, self.gaps))
+        sys.stdout.flush()
+        if self.out:
+            self.out.flush()
+        self.window_records = 0
+        self.window_bytes = 0
+        self.window_start = now
+
+    async def handle(self, reader, writer):
+        peer = writer.get_extra_info('peername')
+        key = None
+        unacked = 0
+        last_ack = time.monotonic()
+        try:
+            while True:
+                try:
+                    hdr = await asyncio.wait_for(reader.readexactly(HDR.size),
+                                                 self.args.ack_ms / 1000.0)
+                except asyncio.TimeoutError:
+                    # stream went idle, acknowledge the tail of the last batch
+                    if unacked:
+                        self.ack(writer, self.last_seq[key])
+                        await writer.drain()
+                        unacked = 0
+                        last_ack = time.monotonic()
+                    continue
+                length, msg_type = HDR.unpack(hdr)
+                body = await reader.readexactly(length - 1)
+                self.bytes += length + 2
+                self.window_bytes += length + 2
+
+                if msg_type == MSG_HELLO:
+                    magic, version, root, session, tail_seq = HELLO.unpack_from(body)
+                    if magic != MAGIC or version != VERSION:
+                        print('%s: bad hello magic:0x%x version:%d' % (peer, magic, version))
+                        return
+                    key = (root, session)
+                    self.last_seq.setdefault(key, tail_seq - 1)
+                    print('%s: root %s session %08x, resume after %d'
+                          % (peer, mac_str(root), session, self.last_seq[key]))
+                    self.ack(writer, self.last_seq[key])
+                elif msg_type == MSG_RECORD and key is not None:
+                    self.store(key, RECORD.unpack_from(body))
+                    unacked += 1
+
+                now = time.monotonic()
+                if unacked and (unacked >= self.args.ack_every
+                                or now - last_ack >= self.args.ack_ms / 1000.0):
+                    self.ack(writer, self.last_seq[key])
+                    await writer.drain()
+                    unacked = 0
+                    last_ack = now
+        except (asyncio.IncompleteReadError, ConnectionError):
+            pass
+        finally:
+            if key is not None and unacked:
+                try:
+                    self.ack(writer, self.last_seq[key])
+                except ConnectionError:
+                    pass
+            print('%s: disconnected' % (peer,))
+            writer.close()
+
+    async def reporter(self):
+        while True:
+            await asyncio.sleep(self.args.interval)
+            self.report()
+
+
+async def main(args):
+    collector = Collector(args)
+    server = await asyncio.start_server(collector.handle, args.host, args.port)
+    print('listening on %s:%d' % (args.host, args.port))
+    asyncio.ensure_future(collector.reporter())
+    async with server:
+        await server.serve_forever()
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Mesh binary uplink collector')
+    parser.add_argument('--host', default='0.0.0.0')
+    parser.add_argument('--port', type=int, default=3001)
+    parser.add_argument('--ack-every', type=int, default=32, help='records per acknowledgement')
+    parser.add_argument('--ack-ms', type=int, default=200, help='longest delay before acknowledging')
+    parser.add_argument('--interval', type=float, default=5.0, help='seconds between rate reports')
+    parser.add_argument('--csv', help='append decoded records to this file')
+    parser.add_argument('-v', '--verbose', action='store_true')
+    try:
+        asyncio.run(main(parser.parse_args()))
+    except KeyboardInterrupt:
+        pass
@@ -0,0 +1,67 @@
+#!/usr/bin/env python3
+#
+# Root pipeline benchmark for the task topology options (MESH_TASK_* in menuconfig).
+#
+# Samples the root's /stats endpoint at the start and end of a window and
+# reports ingest throughput and, per pipeline stage, the share of time spent
+# working and the average and worst cost of one work item. Run it once per
+# build with --label and --csv to compare core and priority layouts.
+#
+# This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+import argparse
+import json
+import os
+import time
+import urllib.request
+
+STAGES = ('rx', 'tx', 'uplink')
+
+
+def fetch(host, port):
+    with urllib.request.urlopen('http://%s:%d/stats' % (host, port), timeout=5) as resp:
+        return json.loads(resp.read().decode())
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Mesh root task topology benchmark')
+    parser.add_argument('host')
+    parser.add_argument('--port', type=int, default=80)
+    parser.add_argument('--duration', type=float, default=60.0, help='seconds')
+    parser.add_argument('--label', default='', help='name of the layout under test')
+    parser.add_argument('--csv', help='append the result to this file')
+    args = parser.parse_args()
+
+    start = fetch(args.host, args.port)
+    t0 = time.monotonic()
+    time.sleep(args.duration)
+    end = fetch(args.host, args.port)
+    elapsed = time.monotonic() - t0
+
+    received = end['received'] - start['received']
+    dropped = (end['duplicates'] - start['duplicates']) + (end['lost'] - start['lost'])
+    print('%s frames/s:%.1f lost+dup:%d role_changes:%d'
+          % (args.label or 'root', received / elapsed, dropped,
+             end['tasks']['role_changes'] - start['tasks']['role_changes']))
+    row = [args.label, '%.1f' % (received / elapsed)]
+    for stage in STAGES:
+        a = start['tasks'][stage]
+        b = end['tasks'][stage]
+        runs = b['runs'] - a['runs']
+        busy = b['busy_us'] - a['busy_us']
+        print('  %-6s core:%2d prio:%2d runs:%7d busy:%5.1f%% avg:%6dus max:%7dus stack_free:%d'
+              % (stage, b['core'], b['prio'], runs, busy / (elapsed * 1e6) * 100,
+                 busy // runs if runs else 0, b['busy_us_max'], b['stack_free']))
+        row += [str(b['core']), str(b['prio']), str(runs), '%.1f' % (busy / (elapsed * 1e6) * 100)]
+
+    if args.csv:
+        new = not os.path.exists(args.csv)
+        with open(args.csv, 'a') as out:
+            if new:
+                out.write(','.join(['label', 'frames_per_s'] + ['%s_%s' % (s, f) for s in STAGES
+                                                                for f in ('core', 'prio', 'runs', 'busy_pct')]) + '\n')
+            out.write(','.join(row) + '\n')
+
+
+if __name__ == '__main__':
+    main()